@@ -0,0 +1,85 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <flac_codec/decode/byte_flac_input.h>
+#include <iostream>
+#include <vector>
+
+#include "stream_builder.h"
+#include "timer.h"
+
+using namespace flac;
+
+namespace {
+
+  const size_t RUNS = 5;
+  const size_t NUM_FIELDS = size_t{ 1 } << 22U;
+  const size_t NUM_RESIDUALS = size_t{ 1 } << 22U;
+  // A quiet, a typical and a loud partition
+  const std::array<size_t, 3> RICE_PARAMS{ 2, 8, 14 };
+
+  uint64_t next_random(uint64_t &state)
+  {
+    state = state * 6364136223846793005U + 1442695040888963407U;
+    return state >> 16U;
+  }
+
+  // Fields of 1 to 32 bits, as frame and subframe headers mix them
+  void bench_read_uint()
+  {
+    BitWriter out;
+    std::vector<size_t> widths(NUM_FIELDS);
+    uint64_t state = 1;
+    size_t total_bits = 0;
+    for (auto &width : widths) {
+      width = 1 + next_random(state) % 32;
+      out.write(next_random(state), width);
+      total_bits += width;
+    }
+    out.align();
+
+    uint64_t sum = 0;
+    auto seconds = time_best(RUNS, [&] {
+      ByteFlacInput input(out.get_bytes());
+      for (const auto width : widths) { sum += static_cast<uint64_t>(input.read_uint(width)); }
+    });
+    std::cout << "read_uint: " << static_cast<double>(total_bits) / 8 / seconds / 1e6 << " MB/s (checksum " << sum
+              << ")\n";
+  }
+
+  // Residuals of about param bits each, the size a Rice parameter is picked for
+  template<typename T> void bench_rice(size_t param)
+  {
+    BitWriter out;
+    uint64_t state = param;
+    for (size_t i = 0; i < NUM_RESIDUALS; ++i) {
+      auto value = static_cast<int64_t>(next_random(state) % (uint64_t{ 1 } << (param + 1))) - (int64_t{ 1 } << param);
+      auto folded = (static_cast<uint64_t>(value) << 1U) ^ static_cast<uint64_t>(value >> 63U);
+      for (auto quotient = folded >> param; quotient > 0; --quotient) { out.write(0, 1); }
+      out.write(1, 1);
+      out.write(folded, param);
+    }
+    out.align();
+
+    std::vector<T> result(NUM_RESIDUALS);
+    auto seconds = time_best(RUNS, [&] {
+      ByteFlacInput input(out.get_bytes());
+      input.read_rice_signed_ints(param, result, 0, NUM_RESIDUALS);
+    });
+    std::cout << "read_rice_signed_ints, " << sizeof(T) * 8 << "-bit, param " << param << ": "
+              << static_cast<double>(NUM_RESIDUALS) / seconds / 1e6 << " M residuals/s\n";
+  }
+
+}// namespace
+
+// Times the bit reader's refill through read_uint and its Rice decoder into both sample widths
+int main()
+{
+  bench_read_uint();
+  for (const auto param : RICE_PARAMS) {
+    bench_rice<int64_t>(param);
+    bench_rice<int32_t>(param);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <flac_codec/common/crc.h>
+#include <iostream>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "timer.h"
+
+using namespace flac;
+
+namespace {
+
+  const size_t RUNS = 5;
+  // Bytes hashed per timed run, split into calls of each length
+  const size_t BYTES_PER_RUN = size_t{ 64 } << 20U;
+  // A frame header, a refill window and a large frame
+  const std::array<size_t, 3> LENGTHS{ 16, 4096, size_t{ 1 } << 20U };
+  const std::array<std::pair<Crc::Engine, const char *>, 3> ENGINES{ {
+    { Crc::Engine::Table, "Table" },
+    { Crc::Engine::Slice8, "Slice8" },
+    { Crc::Engine::Clmul, "Clmul" },
+  } };
+
+  template<typename Update> double bytes_per_second(std::span<const uint8_t> data, Update &&update)
+  {
+    const size_t calls = BYTES_PER_RUN / data.size();
+    auto seconds = time_best(RUNS, [&] {
+      for (size_t i = 0; i < calls; ++i) { update(data); }
+    });
+    return static_cast<double>(calls * data.size()) / seconds;
+  }
+
+}// namespace
+
+// Times CRC-8 and CRC-16 for every engine at a few call lengths. Clmul for CRC-8, and any engine the CPU lacks, runs
+// Slice8 instead and reports its numbers.
+int main()
+{
+  std::vector<uint8_t> bytes(LENGTHS.back());
+  uint32_t state = 1;
+  for (auto &byte : bytes) {
+    state = state * 1664525U + 1013904223U;
+    byte = static_cast<uint8_t>(state >> 24U);
+  }
+
+  // Each result feeds the next call, so the calls cannot be dropped or overlapped
+  uint8_t crc8 = 0;
+  uint16_t crc16 = 0;
+  for (const auto &[engine, name] : ENGINES) {
+    for (const auto len : LENGTHS) {
+      auto data = std::span<const uint8_t>(bytes).first(len);
+      auto rate8 = bytes_per_second(data, [&](auto span) { crc8 = Crc::update_crc8(crc8, span, engine); });
+      auto rate16 = bytes_per_second(data, [&](auto span) { crc16 = Crc::update_crc16(crc16, span, engine); });
+      std::cout << name << ", " << len << " bytes: CRC-8 " << rate8 / 1e9 << " GB/s, CRC-16 " << rate16 / 1e9
+                << " GB/s\n";
+    }
+  }
+  std::cout << "checksums " << int{ crc8 } << " " << crc16 << "\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <flac_codec/common/stream_info.h>
+#include <flac_codec/decode/flac_decoder.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "stream_builder.h"
+#include "timer.h"
+
+using namespace flac;
+
+namespace {
+
+  const size_t RUNS = 5;
+  // One minute of 16-bit stereo at 44.1 kHz when no file is given
+  const size_t GENERATED_SAMPLES = size_t{ 60 } * 44100;
+
+  // Decodes the whole file into a buffer of one block and returns the number of samples per channel
+  template<typename Buffer> uint64_t decode_file(const std::string &path)
+  {
+    FlacDecoder dec(path, FlacDecoder::InputType::Mmap);
+    while (dec.read_and_handle_metadata_block().has_value()) {}
+    Buffer buf(dec.m_stream_info->m_num_channels, typename Buffer::value_type(dec.m_stream_info->m_max_block_size));
+    uint64_t total = 0;
+    while (auto block_size = dec.read_audio_block(buf, 0)) { total += block_size; }
+    return total;
+  }
+
+  template<typename Buffer> void report(const std::string &name, const std::string &path)
+  {
+    uint64_t total = 0;
+    auto seconds = time_best(RUNS, [&] { total = decode_file<Buffer>(path); });
+    std::cout << name << ": " << seconds * 1000 << " ms, " << static_cast<double>(total) / seconds / 1e6
+              << " M samples/s per channel\n";
+  }
+
+}// namespace
+
+// Times a whole decode with 64-bit and then 32-bit sample buffers. Takes a FLAC file, or encodes noise when there is
+// none, which only exercises VERBATIM subframes.
+int main(int argc, char **argv)
+{
+  try {
+    std::unique_ptr<TempFile> generated;
+    std::string path;
+    if (argc > 1) {
+      path = argv[1];// NOLINT
+    } else {
+      const StreamSpec spec;
+      generated = std::make_unique<TempFile>("flac_codec_decode_benchmark.flac",
+        encode_stream(spec, make_noise(2, GENERATED_SAMPLES, spec.m_bit_depth, 1)).m_bytes);
+      path = generated->get_path();
+    }
+
+    FlacDecoder probe(path);
+    while (probe.read_and_handle_metadata_block().has_value()) {}
+    report<Samples>("Samples", path);
+    // A 32-bit stream's side channel does not fit
+    if (probe.m_stream_info->m_bit_depth <= 31) { report<Samples32>("Samples32", path); }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
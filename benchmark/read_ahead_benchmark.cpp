@@ -0,0 +1,84 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <flac_codec/common/stream_info.h>
+#include <flac_codec/decode/flac_decoder.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "stream_builder.h"
+#include "timer.h"
+
+using namespace flac;
+
+namespace {
+
+  const size_t RUNS = 5;
+  // Ten minutes of 16-bit stereo at 44.1 kHz when no file is given, large enough for the reads to matter
+  const size_t GENERATED_SAMPLES = size_t{ 600 } * 44100;
+  const std::array<std::pair<FlacDecoder::InputType, const char *>, 3> INPUT_TYPES{ {
+    { FlacDecoder::InputType::File, "File" },
+    { FlacDecoder::InputType::ReadAhead, "ReadAhead" },
+    { FlacDecoder::InputType::Mmap, "Mmap" },
+  } };
+
+  // Asks the kernel to drop the file's cached pages, so the next decode waits on the disk. Only clean pages go, which
+  // is all of them for a file that is just read.
+  void drop_cache(const std::string &path)
+  {
+    auto fd = open(path.c_str(), O_RDONLY);// NOLINT
+    if (fd < 0) { return; }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+
+  uint64_t decode_file(const std::string &path, FlacDecoder::InputType input_type)
+  {
+    FlacDecoder dec(path, input_type);
+    while (dec.read_and_handle_metadata_block().has_value()) {}
+    Samples buf(dec.m_stream_info->m_num_channels, std::vector<int64_t>(dec.m_stream_info->m_max_block_size));
+    uint64_t total = 0;
+    while (auto block_size = dec.read_audio_block(buf, 0)) { total += block_size; }
+    return total;
+  }
+
+}// namespace
+
+// Times a whole decode through each input, first from the page cache and then with the file evicted before every run,
+// where read-ahead overlaps the disk with decoding. Takes a FLAC file, or encodes noise when there is none.
+int main(int argc, char **argv)
+{
+  try {
+    std::unique_ptr<TempFile> generated;
+    std::string path;
+    if (argc > 1) {
+      path = argv[1];// NOLINT
+    } else {
+      const StreamSpec spec;
+      generated = std::make_unique<TempFile>("flac_codec_read_ahead_benchmark.flac",
+        encode_stream(spec, make_noise(2, GENERATED_SAMPLES, spec.m_bit_depth, 1)).m_bytes);
+      path = generated->get_path();
+    }
+
+    for (const auto &[input_type, name] : INPUT_TYPES) {
+      decode_file(path, input_type);
+      auto warm = time_best(RUNS, [&] { decode_file(path, input_type); });
+      auto cold = time_best(RUNS, [&] {
+        drop_cache(path);
+        decode_file(path, input_type);
+      });
+      std::cout << name << ": " << warm * 1000 << " ms cached, " << cold * 1000 << " ms evicted\n";
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+
+namespace flac {
+
+// Best of runs calls to fn in seconds, the one least disturbed by other work on the machine
+template<typename Fn> double time_best(size_t runs, Fn &&fn)
+{
+  auto best = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+}// namespace flac
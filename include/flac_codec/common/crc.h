@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace flac {
+
+// CRC-8 (poly 0x07) and CRC-16 (poly 0x8005) as used by FLAC frame headers and footers, MSB-first with zero init
+class Crc
+{
+public:
+  enum class Engine : uint8_t {
+    Table,// One table lookup per byte
+    Slice8,// Eight table lookups per 8-byte word
+    Clmul,// PCLMULQDQ folding, x86 only
+  };
+
+  static uint8_t update_crc8(uint8_t crc, std::span<const uint8_t> data);
+  static uint16_t update_crc16(uint16_t crc, std::span<const uint8_t> data);
+
+  // Runs a specific engine, an engine the CPU does not support falls back to Slice8
+  static uint8_t update_crc8(uint8_t crc, std::span<const uint8_t> data, Engine engine);
+  static uint16_t update_crc16(uint16_t crc, std::span<const uint8_t> data, Engine engine);
+
+  // Fastest CRC-16 engine on this CPU, detected once
+  static Engine get_crc16_engine();
+};
+
+}// namespace flac
@@ -12,7 +12,8 @@ class FrameInfo
 public:
   FrameInfo();
 
-  static std::optional<FrameInfo> read_frame(IFlacLowLevelInput &input);
+  // Templated on the input class so the header fields are read without virtual dispatch
+  template<typename Input> static std::optional<FrameInfo> read_frame(Input &input);
 
   std::optional<uint32_t> m_frame_index;
   std::optional<size_t> m_sample_offset;
@@ -24,9 +25,9 @@ public:
   std::optional<uint32_t> m_frame_size;
 
 private:
-  static std::optional<uint64_t> read_utf8_integer(IFlacLowLevelInput &input);
-  static uint32_t decode_block_size(uint8_t code, IFlacLowLevelInput &input);
-  static std::optional<uint32_t> decode_sample_rate(uint8_t code, IFlacLowLevelInput &input);
+  template<typename Input> static std::optional<uint64_t> read_utf8_integer(Input &input);
+  template<typename Input> static uint32_t decode_block_size(uint8_t code, Input &input);
+  template<typename Input> static std::optional<uint32_t> decode_sample_rate(uint8_t code, Input &input);
   static std::optional<uint16_t> decode_bit_depth(uint8_t code);
 
   // void write_header(BitOuputStream out);
@@ -6,7 +6,7 @@
 
 namespace flac {
 
-class ByteFlacInput : public FlacLowLevelInput
+class ByteFlacInput final : public FlacLowLevelInput
 {
 private:
   std::vector<uint8_t> m_data;
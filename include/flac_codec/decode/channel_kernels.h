@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace flac {
+
+// Output stage of a frame: undoes inter-channel decorrelation and stores the samples into the caller's buffers in a
+// single pass, optionally range-checking them on the way
+class ChannelKernels
+{
+public:
+  enum class StereoMode : uint8_t {
+    LeftSide,// first = left, second = left - right
+    SideRight,// first = left - right, second = right
+    MidSide,// first = (left + right) >> 1, second = left - right
+  };
+
+  enum class Engine : uint8_t {
+    Scalar,
+    Sse42,// 2 int64_t or 4 int32_t samples per vector, x86 only
+    Avx2,// 4 int64_t or 8 int32_t samples per vector, x86 only
+  };
+
+  // Writes first.size() samples to left and right. With check set, returns false if any of them is not a signed
+  // bit_depth-bit value; which one is left to the caller to find.
+  static bool store_stereo(StereoMode mode,
+    std::span<const int64_t> first,
+    std::span<const int64_t> second,
+    std::span<int64_t> left,
+    std::span<int64_t> right,
+    uint32_t bit_depth,
+    bool check);
+  static bool store_stereo(StereoMode mode,
+    std::span<const int32_t> first,
+    std::span<const int32_t> second,
+    std::span<int32_t> left,
+    std::span<int32_t> right,
+    uint32_t bit_depth,
+    bool check);
+
+  // Same for an independently coded channel
+  static bool store_channel(std::span<const int64_t> src, std::span<int64_t> dst, uint32_t bit_depth, bool check);
+  static bool store_channel(std::span<const int32_t> src, std::span<int32_t> dst, uint32_t bit_depth, bool check);
+
+  // Runs a specific engine, an engine the CPU does not support falls back to Scalar
+  static bool store_stereo(StereoMode mode,
+    std::span<const int64_t> first,
+    std::span<const int64_t> second,
+    std::span<int64_t> left,
+    std::span<int64_t> right,
+    uint32_t bit_depth,
+    bool check,
+    Engine engine);
+  static bool store_stereo(StereoMode mode,
+    std::span<const int32_t> first,
+    std::span<const int32_t> second,
+    std::span<int32_t> left,
+    std::span<int32_t> right,
+    uint32_t bit_depth,
+    bool check,
+    Engine engine);
+
+  // Fastest engine on this CPU, detected once
+  static Engine get_engine();
+};
+
+}// namespace flac
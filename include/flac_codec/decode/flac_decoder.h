@@ -5,6 +5,11 @@
 #include <flac_codec/common/stream_info.h>
 #include <flac_codec/decode/flac_low_level_input.h>
 #include <flac_codec/decode/frame_decoder.h>
+#include <flac_codec/decode/frame_index.h>
+#include <flac_codec/decode/frame_scanner.h>
+#include <flac_codec/decode/pcm_kernels.h>
+#include <flac_codec/decode/sample_buffer.h>
+#include <flac_codec/decode/seek_planner.h>
 #include <memory>
 #include <optional>
 #include <string>
@@ -14,6 +19,8 @@
 namespace flac {
 
 using Samples = std::vector<std::vector<int64_t>>;
+// Half the size of Samples; holds every stream of up to 32 bits
+using Samples32 = std::vector<std::vector<int32_t>>;
 
 class FlacDecoder
 {
@@ -21,19 +28,71 @@ public:
   std::unique_ptr<StreamInfo> m_stream_info;
   std::unique_ptr<SeekTable> m_seek_table;
 
-  explicit FlacDecoder(const std::string &file_name);
+  enum class InputType : uint8_t {
+    File,// Buffered std::fstream reads
+    Mmap,// Whole file mapped, no copies and pointer-only seeks
+    ReadAhead,// Background thread prefetches the next chunk while the current one is decoded
+  };
+
+  explicit FlacDecoder(const std::string &file_name,
+    InputType input_type = InputType::File,
+    ValidationLevel validation = ValidationLevel::Strict);
 
   std::optional<std::pair<uint8_t, std::vector<uint8_t>>> read_and_handle_metadata_block();
   uint32_t read_audio_block(Samples &samples, size_t offset);
+  uint32_t read_audio_block(Samples32 &samples, size_t offset);
+  // Writes formatted PCM instead, offset counts frames
+  uint32_t read_audio_block(const PcmBuffer &out, size_t offset);
+  uint32_t read_audio_block(const SampleBuffer &out, size_t offset);
+  // Decodes whole frames into out until the next one would not fit and returns the number of frames written. Never
+  // splits a frame, so 0 means either the end of the stream or a buffer smaller than the next block; a buffer of
+  // m_max_block_size frames always takes at least one.
+  size_t read_audio_blocks(const SampleBuffer &out);
+  // Moves past the next frame without decoding its audio, for jobs that only need frame positions and sizes.
+  // std::nullopt at the end of the stream.
+  std::optional<FrameLocation> skim_audio_block();
+  // Block size of the next frame without consuming it, std::nullopt at the end of the stream
+  std::optional<uint32_t> peek_block_size();
+  // Writes the samples from pos to the end of the frame holding it at offset, and returns how many there are. Needs no
+  // allocations after the first call.
   uint32_t seek_and_read_audio_block(uint64_t pos, Samples &samples, size_t offset);
+  uint32_t seek_and_read_audio_block(uint64_t pos, Samples32 &samples, size_t offset);
+  // File offset of the first frame, known once the last metadata block has been read
+  [[nodiscard]] std::optional<uint64_t> get_metadata_end_pos() const;
+  // Seeks then go straight to the frame holding the target sample instead of through the seek table
+  void set_frame_index(FrameIndex index);
+  // Only channels whose bit is set are decoded, see IFrameDecoder::set_channel_mask. Output channels stay indexed by
+  // channel number and the others are left untouched.
+  void set_channel_mask(uint8_t mask);
 
 private:
   std::unique_ptr<IFlacLowLevelInput> m_input;
+  InputType m_input_type;
+  ValidationLevel m_validation;
   std::optional<uint64_t> m_metadata_end_pos;
-  std::unique_ptr<FrameDecoder> m_frame_dec;
+  std::unique_ptr<IFrameDecoder> m_frame_dec;
+  std::optional<FrameIndex> m_frame_index;
+  SeekPlanner m_seek_planner;
+  uint8_t m_channel_mask{ IFrameDecoder::ALL_CHANNELS };
+  // Channels of m_max_block_size samples in the frame decoder's own sample type, allocated on the first seek
+  Samples m_seek_scratch;
+  Samples32 m_seek_scratch32;
+  std::vector<uint8_t> m_sync_scratch;// Bytes searched for frame headers, for inputs that are not mapped
+  std::vector<size_t> m_sync_offsets;
+
+  template<typename Input> void create_frame_decoder();
+  template<typename Input, ValidationLevel Level> void create_frame_decoder();
+  template<typename Output> uint32_t read_audio_block_into(Output &out, size_t offset);
+  template<typename Output> uint32_t seek_and_read_audio_block_into(uint64_t pos, Output &samples, size_t offset);
+  template<typename Scratch, typename Output>
+  uint32_t seek_and_read_audio_block_via(uint64_t pos, Scratch &scratch, Output &samples, size_t offset);
+  static size_t get_read_ahead_chunk_size(const StreamInfo &info);
 
-  [[nodiscard]] std::pair<uint64_t, uint64_t> get_best_seek_point(uint64_t pos) const;
-  std::pair<uint64_t, uint64_t> seek_by_sync_and_decode(uint64_t pos);
+  // Frame to start decoding from to reach sample pos, found with the least estimated I/O and decoding
+  SeekPlanner::Point plan_seek(uint64_t pos);
+  // The frame at the current input position, std::nullopt at the end of the stream or in the middle of a frame
+  std::optional<SeekPlanner::Point> get_current_point();
+  void record_frame(const FrameInfo &frame);
   std::optional<std::pair<uint64_t, uint64_t>> get_next_frame_offsets(uint64_t file_pos);
   [[nodiscard]] uint64_t get_sample_offset(FrameInfo &frame) const;
   void close();
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <sys/types.h>
 #include <vector>
 
@@ -20,7 +24,10 @@ public:
 
   virtual int64_t read_uint(size_t num_of_bits) = 0;
   virtual int32_t read_signed_int(size_t num_of_bits) = 0;
+  // Up to 64 bits, for the 33-bit side channel of a 32-bit stream
+  virtual int64_t read_signed_long(size_t num_of_bits) = 0;
   virtual void read_rice_signed_ints(size_t param, std::vector<int64_t> &result, size_t start, size_t end) = 0;
+  virtual void read_rice_signed_ints(size_t param, std::vector<int32_t> &result, size_t start, size_t end) = 0;
 
   [[nodiscard]] virtual std::optional<uint8_t> read_byte() = 0;
   virtual void read_fully(std::vector<uint8_t> &bytes) = 0;
@@ -37,6 +44,7 @@ class FlacLowLevelInput : public IFlacLowLevelInput
 private:
   size_t m_byte_buffer_start_pos;
   std::vector<uint8_t> m_byte_buffer;
+  const uint8_t *m_byte_data;
   std::optional<size_t> m_byte_buffer_len;
   size_t m_byte_buffer_index;
 
@@ -45,6 +53,8 @@ private:
 
   uint8_t m_crc8;
   uint16_t m_crc16;
+  // CRC-8 only covers the frame header, so it stops accumulating after get_crc8() until the next reset_crcs()
+  bool m_crc8_finished;
   std::optional<size_t> m_crc_start_index;
 
   void check_byte_aligned() const;
@@ -52,6 +62,11 @@ private:
   std::optional<uint8_t> read_underlying();
   void update_crcs(size_t unused_trailing_bytes);
 
+  uint64_t read_rice_code(size_t param);
+  template<typename T> void read_rice_signed_ints_of(size_t param, std::vector<T> &result, size_t start, size_t end);
+  template<typename T> void read_rice_signed_ints_table(size_t param, std::vector<T> &result, size_t start, size_t end);
+  template<typename T> void read_rice_signed_ints_clz(size_t param, std::vector<T> &result, size_t start, size_t end);
+
 public:
   FlacLowLevelInput();
 
@@ -60,9 +75,20 @@ public:
 
   int64_t read_uint(size_t num_of_bits) override;
   int32_t read_signed_int(size_t num_of_bits) override;
+  int64_t read_signed_long(size_t num_of_bits) override;
   void read_rice_signed_ints(size_t param, std::vector<int64_t> &result, size_t start, size_t end) override;
+  // Residuals of streams up to 31 bits fit in 32 bits, wider values are truncated
+  void read_rice_signed_ints(size_t param, std::vector<int32_t> &result, size_t start, size_t end) override;
   std::optional<uint8_t> read_byte() override;
   void read_fully(std::vector<uint8_t> &bytes) override;
+  // Consume input without extracting values; skipped bytes still count towards the CRCs
+  void skip_bits(uint64_t num_of_bits);
+  void skip_rice_codes(size_t param, size_t count);
+  // Advances to the next frame sync code without consuming it, false at the end of the stream. Byte-aligned only.
+  bool skip_to_sync_code();
+  // The bytes from the position to the end of the window, without consuming them; empty when some of the buffered bits
+  // came from the window before. Byte-aligned only.
+  [[nodiscard]] std::span<const uint8_t> peek_window() const;
   void reset_crcs() override;
   [[nodiscard]] uint8_t get_crc8() override;
   [[nodiscard]] uint16_t get_crc16() override;
@@ -71,20 +97,55 @@ public:
 protected:
   void position_changed(size_t pos);
   virtual std::optional<uint64_t> read_underlying(std::vector<uint8_t> &buf, size_t off, size_t len) = 0;
+  // Returns the next bytes of the stream for the bit reader to consume in place. The default copies through
+  // read_underlying() into the internal buffer; inputs that already hold the bytes in memory return them directly.
+  virtual std::span<const uint8_t> read_underlying_window();
+};
 
-private:
-  static const size_t RICE_DECODING_TABLE_BITS = 13;
-  static const size_t RICE_DECODING_TABLE_MASK = (1U << RICE_DECODING_TABLE_BITS) - 1U;
-  static std::vector<std::vector<uint8_t>> RICE_DECODING_CONSUMED_TABLES;
-  static std::vector<std::vector<uint32_t>> RICE_DECODING_VALUE_TABLES;
-  static const size_t RICE_DECODING_CHUNK = 4;
-
-  static void initialize_tables();
-
-  static std::vector<uint8_t> CRC8_TABLE;
-  static std::vector<uint16_t> CRC16_TABLE;
+// The bit reader is defined here so that decoders templated on a concrete (final) input class can inline it
+inline int64_t FlacLowLevelInput::read_uint(size_t num_of_bits)
+{
+  if (num_of_bits > 32) {
+    const std::string msg{ "num_of_bits= " + std::to_string(num_of_bits) + ", is greater than 32" };
+    throw std::invalid_argument(msg);
+  }
+
+  if (num_of_bits == 0) { return 0; }
+  while (m_bit_buffer_len < num_of_bits) { fill_bit_buffer(); }
+
+  auto result = m_bit_buffer >> (m_bit_buffer_len - num_of_bits);
+  if (num_of_bits != 32) {
+    result &= (1U << num_of_bits) - 1U;
+    assert((result >> num_of_bits) == 0U);
+    m_bit_buffer_len -= num_of_bits;
+    assert(m_bit_buffer_len <= 64U);
+    return static_cast<uint32_t>(result);
+  } else {
+    m_bit_buffer_len -= num_of_bits;
+    assert(m_bit_buffer_len <= 64U);
+    return static_cast<int32_t>(result);
+  }
+}
+
+inline int32_t FlacLowLevelInput::read_signed_int(size_t num_of_bits)
+{
+  auto shift = 32U - num_of_bits;
+  return static_cast<int32_t>(read_uint(num_of_bits) << shift) >> shift;// NOLINT
+}
 
-  static void initialize_crcs();
-};
+inline int64_t FlacLowLevelInput::read_signed_long(size_t num_of_bits)
+{
+  if (num_of_bits <= 32) { return read_signed_int(num_of_bits); }
+  if (num_of_bits > 64) {
+    const std::string msg{ "num_of_bits= " + std::to_string(num_of_bits) + ", is greater than 64" };
+    throw std::invalid_argument(msg);
+  }
+
+  // read_uint sign-extends a full 32 bits, so both halves are masked back to their own width
+  auto high = static_cast<uint64_t>(read_uint(num_of_bits - 32)) & 0xFFFFFFFFU;
+  auto low = static_cast<uint64_t>(read_uint(32)) & 0xFFFFFFFFU;
+  auto shift = 64U - num_of_bits;
+  return static_cast<int64_t>(((high << 32U) | low) << shift) >> shift;// NOLINT
+}
 
 }// namespace flac
@@ -2,49 +2,130 @@
 
 #include <cstdint>
 #include <flac_codec/common/frame_info.h>
+#include <flac_codec/decode/channel_kernels.h>
 #include <flac_codec/decode/flac_low_level_input.h>
-#include <memory>
+#include <flac_codec/decode/pcm_kernels.h>
+#include <flac_codec/decode/sample_buffer.h>
 #include <optional>
+#include <span>
+#include <utility>
 #include <vector>
 
 namespace flac {
 
-class FrameDecoder
+// How much of the stream is re-checked while decoding. The CRC-16 of every frame is verified at all levels.
+enum class ValidationLevel : uint8_t {
+  Strict,// Every predicted and output sample is range-checked as it is produced
+  Checked,// One range reduction per subframe and per output block instead of a check per sample
+  Trusted,// No sample range checks, for streams that were verified beforehand
+};
+
+// Type-erased front for FrameDecoder, one virtual call per frame instead of one per field
+class IFrameDecoder// NOLINT
+{
+public:
+  virtual ~IFrameDecoder() = default;
+
+  virtual std::optional<FrameInfo> read_frame(std::vector<std::vector<int64_t>> &out_samples, size_t out_offset) = 0;
+  virtual std::optional<FrameInfo> read_frame(std::vector<std::vector<int32_t>> &out_samples, size_t out_offset) = 0;
+  // Formats the frame straight into out, out_offset counts frames
+  virtual std::optional<FrameInfo> read_frame(const PcmBuffer &out, size_t out_offset) = 0;
+  virtual std::optional<FrameInfo> read_frame(const SampleBuffer &out, size_t out_offset) = 0;
+  // Walks over the next frame without decoding it and still verifies its CRC-16. With a max_frame_size the end of the
+  // frame is found by scanning for a sync code where the CRC matches, falling back to parsing the subframes if there
+  // is none that close; 0 always parses them.
+  virtual std::optional<FrameInfo> skim_frame(uint32_t max_frame_size) = 0;
+  // Decodes only the channels whose bit is set, bit n for channel n. The subframes of the others are parsed without
+  // being restored or checked, and their output is left as it was. Stereo pairs are restored only as far as the
+  // requested channel needs.
+  virtual void set_channel_mask(uint8_t mask) = 0;
+
+  // FLAC has at most 8 channels
+  static const uint8_t ALL_CHANNELS = 0xFF;
+};
+
+// Decodes frames from a concrete input class. The input is owned by the caller and must outlive the decoder.
+// Sample is the type subframes are decoded in: int32_t halves the memory traffic of every pass over a block and is
+// exact for streams of up to 31 bits, whose side channel still fits in 32 bits. 32-bit streams need int64_t.
+// Either sample output type can be used with either Sample, at the cost of a conversion pass when they differ.
+template<typename Input, ValidationLevel Level = ValidationLevel::Strict, typename Sample = int64_t>
+class FrameDecoder final : public IFrameDecoder
 {
 public:
-  std::unique_ptr<IFlacLowLevelInput> m_input;
+  Input &m_input;
   uint32_t m_expected_bit_depth{};
 
-  FrameDecoder(std::unique_ptr<IFlacLowLevelInput> &input, uint32_t expect_depth);
+  FrameDecoder(Input &input, uint32_t expect_depth);
 
-  std::optional<FrameInfo> read_frame(std::vector<std::vector<int64_t>> &out_samples, size_t out_offset);
+  std::optional<FrameInfo> read_frame(std::vector<std::vector<int64_t>> &out_samples, size_t out_offset) override;
+  std::optional<FrameInfo> read_frame(std::vector<std::vector<int32_t>> &out_samples, size_t out_offset) override;
+  std::optional<FrameInfo> read_frame(const PcmBuffer &out, size_t out_offset) override;
+  std::optional<FrameInfo> read_frame(const SampleBuffer &out, size_t out_offset) override;
+  std::optional<FrameInfo> skim_frame(uint32_t max_frame_size) override;
+  void set_channel_mask(uint8_t mask) override;
 
 private:
-  std::vector<int64_t> m_temp0;
-  std::vector<int64_t> m_temp1;
+  std::vector<Sample> m_temp0;
+  std::vector<Sample> m_temp1;
   std::optional<uint32_t> m_current_block_size;
+  uint8_t m_channel_mask{ ALL_CHANNELS };
 
-  void decode_subframes(uint32_t bit_depth,
-    int chan_asgn,
-    std::vector<std::vector<int64_t>> &out_samples,
-    size_t out_offset);
+  template<typename Output> std::optional<FrameInfo> read_frame_into(Output &out, size_t out_offset);
+  template<typename Output> void decode_subframes(uint32_t bit_depth, int chan_asgn, Output &out, size_t out_offset);
+  template<typename Output>
+  void decode_stereo_subframes(uint32_t bit_depth, int chan_asgn, Output &out, size_t out_offset);
+  [[nodiscard]] bool is_requested(size_t channel) const;
   static int32_t check_bit_depth(int64_t val, uint32_t depth);
-  void decode_subframe(uint32_t bit_depth, std::vector<int64_t> &result);
-  void decode_fixed_prediction_subframe(int64_t pred_order, uint32_t bit_depth, std::vector<int64_t> &result);
-
-  // NOLINTNEXTLINE
-  static const inline std::vector<std::vector<int64_t>> FIXED_PREDICTION_COEFFICIENTS = {
-    {},
-    { 1 },
-    { 2, -1 },
-    { 3, -3, 1 },
-    { 3, -3, 1 },
-    { 4, -6, 4, -1 },
-  };
-
-  void decode_linear_predictive_coding_subframe(int64_t lpc_order, uint32_t bit_depth, std::vector<int64_t> &result);
-  void restore_lpc(std::vector<int64_t> &result, const std::vector<int64_t> &coefs, uint32_t bit_depth, int shift);
-  void read_residuals(int64_t warmup, std::vector<int64_t> &result);
+  template<typename Out>
+  void store_block(const std::vector<Sample> &block,
+    std::vector<std::vector<Out>> &out_samples,
+    size_t channel,
+    size_t out_offset,
+    uint32_t bit_depth);
+  void store_block(const std::vector<Sample> &block,
+    const PcmBuffer &out,
+    size_t channel,
+    size_t out_offset,
+    uint32_t bit_depth);
+  void store_block(const std::vector<Sample> &block,
+    const SampleBuffer &out,
+    size_t channel,
+    size_t out_offset,
+    uint32_t bit_depth);
+  template<typename Out>
+  void store_stereo_block(ChannelKernels::StereoMode mode,
+    std::vector<std::vector<Out>> &out_samples,
+    size_t out_offset,
+    uint32_t bit_depth);
+  void store_stereo_block(ChannelKernels::StereoMode mode, const PcmBuffer &out, size_t out_offset, uint32_t bit_depth);
+  void
+    store_stereo_block(ChannelKernels::StereoMode mode, const SampleBuffer &out, size_t out_offset, uint32_t bit_depth);
+  void restore_stereo(ChannelKernels::StereoMode mode, uint32_t bit_depth);
+  static void check_block(std::span<const Sample> block, uint32_t bit_depth);
+  static void store_pcm(std::span<const Sample> src,
+    const PcmBuffer &out,
+    size_t channel,
+    size_t out_offset,
+    uint32_t bit_depth);
+  template<typename Out>
+  [[noreturn]] static void
+    report_out_of_range(std::span<const Out> left, std::span<const Out> right, uint32_t bit_depth);
+  // Type code and number of wasted bits
+  std::pair<uint32_t, uint32_t> read_subframe_header(uint32_t bit_depth);
+  // One unencoded sample, up to the 33 bits of a side channel when Sample is 64-bit
+  Sample read_sample(uint32_t bit_depth);
+  void decode_subframe(uint32_t bit_depth, std::vector<Sample> &result);
+  void decode_fixed_prediction_subframe(int64_t pred_order, uint32_t bit_depth, std::vector<Sample> &result);
+
+  void decode_linear_predictive_coding_subframe(int64_t lpc_order, uint32_t bit_depth, std::vector<Sample> &result);
+  void restore_lpc(std::vector<Sample> &result, std::span<const int64_t> coefs, uint32_t bit_depth, int shift);
+  void check_restored(const std::vector<Sample> &result, size_t order, uint32_t bit_depth);
+  void read_residuals(int64_t warmup, std::vector<Sample> &result);
+
+  std::optional<size_t> find_frame_end(size_t start_byte, uint32_t max_frame_size, const FrameInfo &meta);
+  void skim_subframes(uint32_t bit_depth, int chan_asgn);
+  void skim_subframe(uint32_t bit_depth);
+  void skim_residuals(uint32_t warmup);
 };
 
 }// namespace flac
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/decode/frame_scanner.h>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace flac {
+
+// Sample offset to byte offset of every frame of one FLAC file, kept in the same compact form in memory and in its
+// sidecar file. Frames are delta-coded as varints in groups; each group starts from an absolute checkpoint, so a
+// lookup is a binary search over the checkpoints plus a short linear walk. The sidecar records the size and mtime of
+// the FLAC file and a checksum of its contents, and is memory-mapped when loaded.
+class FrameIndex
+{
+public:
+  static const size_t FRAMES_PER_CHECKPOINT = 64;
+
+  // Throws DataFormatException unless frames cover the whole stream, from the start of the audio to the end of the file
+  static FrameIndex build(std::span<const FrameLocation> frames, const std::string &flac_file);
+  // Scans the whole file with FrameScanner
+  static FrameIndex build(const std::string &flac_file, uint64_t audio_start, unsigned num_threads = 0);
+  // std::nullopt if the sidecar is missing, corrupt, or was built for another version of the FLAC file
+  static std::optional<FrameIndex> load(const std::string &index_file, const std::string &flac_file);
+  // Loads the sidecar, or builds the index and tries to save it; an index that cannot be saved is still returned
+  static FrameIndex open(const std::string &flac_file, uint64_t audio_start, const std::string &index_file);
+  static std::string get_default_path(const std::string &flac_file);
+
+  // Written to a temporary file first and renamed over index_file
+  void save(const std::string &index_file) const;
+
+  [[nodiscard]] size_t get_num_frames() const;
+  [[nodiscard]] uint64_t get_num_samples() const;
+  // The frame holding sample, std::nullopt past the end of the stream
+  [[nodiscard]] std::optional<FrameLocation> find(uint64_t sample) const;
+
+private:
+  struct Unmap
+  {
+    size_t m_length;
+    void operator()(const uint8_t *ptr) const;
+  };
+
+  std::vector<uint8_t> m_owned;
+  std::unique_ptr<const uint8_t, Unmap> m_mapping;
+  std::span<const uint8_t> m_data;
+
+  FrameIndex() = default;
+
+  [[nodiscard]] uint64_t read_field(size_t offset) const;
+};
+
+}// namespace flac
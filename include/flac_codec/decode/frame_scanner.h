@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flac {
+
+// Where a frame starts in the file and in the stream
+struct FrameLocation
+{
+  uint64_t m_file_offset;
+  uint64_t m_sample_offset;
+  uint32_t m_block_size;
+};
+
+// Finds frame boundaries without decoding any audio. Candidates are sync codes whose header passes its CRC-8; of
+// those only the ones that continue the position of the frame before them are kept, which rejects sync patterns that
+// happen to occur inside compressed audio.
+class FrameScanner
+{
+public:
+  // Scans from audio_start, the end of the metadata, to the end of the file. Candidates are gathered on up to
+  // num_threads threads, 0 uses every hardware thread. Throws DataFormatException unless the frames run up to the end
+  // of the file, as they stop at a damaged or missing frame.
+  static std::vector<FrameLocation> scan(const std::string &filename, uint64_t audio_start, unsigned num_threads = 0);
+};
+
+}// namespace flac
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/decode/flac_decoder.h>
+#include <flac_codec/decode/frame_decoder.h>
+#include <flac_codec/decode/sample_buffer.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace flac {
+
+struct LoudnessResult
+{
+  // EBU R128 integrated loudness in LUFS, std::nullopt when no 400 ms block passes the gates, as for silence
+  std::optional<double> m_integrated_loudness;
+  // Largest over all channels, linear with 1.0 at full scale. The sample peak is also the ReplayGain track peak.
+  double m_sample_peak{};
+  double m_true_peak{};
+  // ReplayGain 2.0 track gain in dB, towards -18 LUFS
+  std::optional<double> m_track_gain;
+};
+
+// EBU R128 / ITU-R BS.1770 loudness, true peak and ReplayGain 2.0, measured from decoded blocks as they come, so a
+// file is never held in full. Block loudness goes to a histogram of 0.01 LU bins, which is all the gating needs.
+//
+// Analyzers of adjacent sample ranges merge exactly: gating blocks lie on a grid of 100 ms steps counted from the start
+// of the stream, histograms add up, and each analyzer keeps the few steps at its edges to form the blocks that straddle
+// the boundary. Filters carry state across samples, so a range starting mid-stream first runs the samples before it
+// through warm_up().
+class LoudnessAnalyzer
+{
+public:
+  // Lead-in that lets the filters settle far below double precision
+  static const uint32_t WARM_UP_MS = 500;
+
+  LoudnessAnalyzer(uint32_t sample_rate, uint32_t num_channels, uint32_t bit_depth, uint64_t first_sample = 0);
+
+  // Feeds num_frames frames of block through the filters without measuring them. Only before the first add().
+  void warm_up(const SampleBuffer &block, size_t num_frames);
+  // Measures the next num_frames frames of block
+  void add(const SampleBuffer &block, size_t num_frames);
+  // Takes in the analysis of the range that starts where this one ends; adding to this one afterwards continues from
+  // the end of next
+  void merge(const LoudnessAnalyzer &next);
+
+  [[nodiscard]] LoudnessResult get_result() const;
+
+  // Analyzes a decoder whose metadata has been read, a block at a time while each one is still in cache
+  static LoudnessResult analyze(FlacDecoder &dec);
+  // Analyzes contiguous ranges of frames on separate threads and merges them in order. num_threads 0 uses every
+  // hardware thread.
+  static LoudnessResult analyze(const std::string &file_name,
+    ValidationLevel validation = ValidationLevel::Strict,
+    unsigned num_threads = 0);
+
+private:
+  static const size_t HISTORY = 11;
+  static const size_t CHUNK = 64;
+
+  struct Biquad
+  {
+    double m_b0{};
+    double m_b1{};
+    double m_b2{};
+    double m_a1{};
+    double m_a2{};
+  };
+
+  struct Channel
+  {
+    // Both stages of the K-weighting, two values each
+    std::array<double, 4> m_state{};
+    double m_weight{};
+    // The last HISTORY samples, then the chunk being processed
+    std::array<double, HISTORY + CHUNK> m_window{};
+  };
+
+  // Weighted sum of squares over the samples of one 100 ms step seen so far
+  struct Step
+  {
+    uint64_t m_index{};
+    double m_energy{};
+    uint32_t m_count{};
+  };
+
+  struct Bin
+  {
+    uint64_t m_count{};
+    double m_energy{};
+  };
+
+  uint32_t m_sample_rate;
+  uint32_t m_step_size;
+  double m_scale;
+  uint64_t m_first_sample;
+  uint64_t m_position;
+  std::array<Biquad, 2> m_k_weighting;
+  std::vector<Channel> m_channels;
+  // The first finished steps and the last ones, at most 4 each
+  std::vector<Step> m_head;
+  std::vector<Step> m_tail;
+  std::vector<Bin> m_histogram;
+  double m_sample_peak = 0;
+  double m_true_peak = 0;
+
+  // Filters len frames of block from offset on and returns their weighted sum of squares; Measure also tracks the
+  // peaks
+  template<bool Measure> double process(const SampleBuffer &block, size_t offset, size_t len);
+  // Runs the chunk in the windows of Count channels through the filters together, so their chains overlap
+  template<size_t Count> double filter(Channel *channels, size_t n) const;
+  void add_to_step(uint64_t index, double energy, uint32_t count);
+  void add_block(double energy);
+  // Whether first and the three steps after it make up a whole 400 ms block
+  [[nodiscard]] bool is_full_block(const Step *first) const;
+  // Head and tail in order, without duplicates
+  [[nodiscard]] std::vector<Step> get_edge_steps() const;
+};
+
+}// namespace flac
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace flac {
+
+// Linear prediction restore loops, specialized per order so the coefficients stay in registers
+class LpcKernels
+{
+public:
+  static const size_t MAX_ORDER = 32;
+  static const size_t MAX_FIXED_ORDER = 4;
+
+  enum class Engine : uint8_t {
+    Scalar,// Per-order unrolled loops, 32-bit accumulators when the sums cannot overflow them
+    Avx2,// 4 taps per multiply for orders of 8 and up, x86 only
+  };
+
+  // On entry data[coefs.size()..] holds residuals and the leading entries the warmup samples, on return it holds
+  // the restored samples. bit_depth must bound the warmup samples; it picks the accumulator width and engine.
+  // Results are not range-checked, that is left to the caller.
+  static void restore(std::span<int64_t> data, std::span<const int64_t> coefs, int shift, uint32_t bit_depth);
+  static void restore(std::span<int32_t> data, std::span<const int64_t> coefs, int shift, uint32_t bit_depth);
+
+  // Runs a specific engine, an engine the CPU does not support falls back to Scalar
+  static void
+    restore(std::span<int64_t> data, std::span<const int64_t> coefs, int shift, uint32_t bit_depth, Engine engine);
+  static void
+    restore(std::span<int32_t> data, std::span<const int64_t> coefs, int shift, uint32_t bit_depth, Engine engine);
+
+  // Fixed predictors of order n integrate the residual n times, so they are restored with running sums seeded from
+  // the differences of the warmup samples instead of multiplies
+  static void restore_fixed(std::span<int64_t> data, size_t order);
+  static void restore_fixed(std::span<int32_t> data, size_t order);
+
+  // Fastest engine on this CPU, detected once
+  static Engine get_engine();
+};
+
+}// namespace flac
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/decode/flac_low_level_input.h>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace flac {
+
+// Maps the whole file and lets the bit reader consume the mapped bytes in place, a seek only moves the read offset
+class MmapFlacInput final : public FlacLowLevelInput
+{
+public:
+  enum class AccessPattern : uint8_t {
+    Sequential,// Linear decode, the kernel reads ahead aggressively
+    Random,// Seek-heavy use, read-ahead is disabled
+  };
+
+  explicit MmapFlacInput(const std::string &filename, AccessPattern pattern = AccessPattern::Sequential);
+  ~MmapFlacInput() override;
+
+  MmapFlacInput(const MmapFlacInput &) = delete;
+  MmapFlacInput &operator=(const MmapFlacInput &) = delete;
+  MmapFlacInput(MmapFlacInput &&) = delete;
+  MmapFlacInput &operator=(MmapFlacInput &&) = delete;
+
+  [[nodiscard]] size_t get_length() const override;
+  void seek_to(size_t pos) override;
+  void close() override;
+
+  void advise(AccessPattern pattern);
+  // The whole mapped file, valid until close()
+  [[nodiscard]] std::span<const uint8_t> get_data() const;
+
+protected:
+  std::optional<uint64_t> read_underlying(std::vector<uint8_t> &buf, size_t off, size_t len) override;
+  std::span<const uint8_t> read_underlying_window() override;
+
+private:
+  int m_fd;
+  const uint8_t *m_data;
+  size_t m_length;
+  size_t m_offset;
+};
+
+}// namespace flac
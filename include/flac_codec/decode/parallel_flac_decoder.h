@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/common/stream_info.h>
+#include <flac_codec/decode/frame_decoder.h>
+#include <flac_codec/decode/frame_scanner.h>
+#include <flac_codec/decode/pcm_kernels.h>
+#include <flac_codec/decode/sample_buffer.h>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace flac {
+
+// Decodes one file on several threads. FrameScanner locates every frame up front, so each frame has a fixed place in
+// the output and the result does not depend on which thread decoded it. Threads claim batches of consecutive frames
+// from a shared counter, which keeps them busy however uneven the frames are.
+class ParallelFlacDecoder
+{
+public:
+  static const size_t FRAMES_PER_BATCH = 16;
+  static const size_t ALL_FRAMES = std::numeric_limits<size_t>::max();
+
+  // num_threads 0 uses every hardware thread
+  explicit ParallelFlacDecoder(const std::string &file_name,
+    ValidationLevel validation = ValidationLevel::Strict,
+    unsigned num_threads = 0);
+
+  [[nodiscard]] const StreamInfo &get_stream_info() const;
+  [[nodiscard]] const std::vector<FrameLocation> &get_frames() const;
+  // Taken from the scan, so it is known even when STREAMINFO leaves the length at 0
+  [[nodiscard]] uint64_t get_num_samples() const;
+
+  // Decodes num_frames frames from first_frame on. Offset 0 of out is the first sample of first_frame, so out must
+  // hold the samples of the whole range for every channel of the stream.
+  void decode(const SampleBuffer &out, size_t first_frame = 0, size_t num_frames = ALL_FRAMES);
+  void decode(const PcmBuffer &out, size_t first_frame = 0, size_t num_frames = ALL_FRAMES);
+
+  // Called on the decoding thread with each frame in a block of its own, at offset 0 of every channel. Calls for
+  // different frames run concurrently and in no particular order.
+  using FrameVisitor = std::function<void(const FrameLocation &frame, const SampleBuffer &block)>;
+  // Decodes every step-th frame from first_frame on, counting num_frames of the stream's frames, into a per-thread
+  // block that stays in cache while visit reduces it. No output for the whole range is needed.
+  void visit(const FrameVisitor &visit, size_t step = 1, size_t first_frame = 0, size_t num_frames = ALL_FRAMES);
+
+  // Called with the frames of one range in stream order, all on the same thread. Frames with lead_in set come from
+  // before the range and are decoded only to settle state that carries over from one frame to the next.
+  using RangeVisitor =
+    std::function<void(size_t range, const FrameLocation &frame, const SampleBuffer &block, bool lead_in)>;
+  // Splits the stream into ranges of frames_per_range frames, range r starting at frame r * frames_per_range, and has
+  // each one decoded by a single thread, after up to lead_in_frames frames before it
+  void visit_ranges(size_t frames_per_range, size_t lead_in_frames, const RangeVisitor &visit);
+
+private:
+  std::string m_file_name;
+  ValidationLevel m_validation;
+  unsigned m_num_threads;
+  StreamInfo m_stream_info;
+  std::vector<FrameLocation> m_frames;
+
+  template<typename Output> void decode_into(const Output &out, size_t first_frame, size_t num_frames);
+  // Calls make_worker() once per thread, then the callable it returns as (decoder, batch, idx) for every step-th frame
+  // of each batch of batch_span frames the thread claims, with the decoder's input at that frame. With a step of 1,
+  // each batch is preceded by up to lead_in frames before it.
+  template<typename MakeWorker>
+  void run_batches(size_t first_frame,
+    size_t end_frame,
+    size_t batch_span,
+    size_t step,
+    size_t lead_in,
+    const MakeWorker &make_worker);
+  // A planar block of STREAMINFO's maximum size over storage
+  SampleBuffer make_block(std::vector<int32_t> &storage) const;
+  // Throws unless the decoder returned the frame the scan found at idx
+  void check_frame(const std::optional<FrameInfo> &frame, size_t idx) const;
+};
+
+}// namespace flac
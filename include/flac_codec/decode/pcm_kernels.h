@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace flac {
+
+// Converts decoded samples to packed little-endian PCM. Samples are rescaled from the stream's bit depth to the width
+// of the encoding by shifting, so narrowing truncates; float output is normalized to [-1, 1).
+class PcmKernels
+{
+public:
+  enum class Encoding : uint8_t {
+    S16,// 2-byte signed
+    S24,// 3-byte signed, packed
+    S32,// 4-byte signed
+    F32,// IEEE single precision
+  };
+
+  enum class Engine : uint8_t {
+    Scalar,
+    Avx2,// 8 int32_t samples per vector, x86 only; int64_t samples always take the scalar path
+  };
+
+  static size_t get_sample_size(Encoding encoding);
+
+  // Writes src.size() samples to dst, stride bytes apart
+  static void store_channel(std::span<const int32_t> src,
+    std::span<std::byte> dst,
+    size_t stride,
+    Encoding encoding,
+    uint32_t bit_depth);
+  static void store_channel(std::span<const int64_t> src,
+    std::span<std::byte> dst,
+    size_t stride,
+    Encoding encoding,
+    uint32_t bit_depth);
+
+  // Writes left.size() interleaved left/right pairs to dst
+  static void store_stereo(std::span<const int32_t> left,
+    std::span<const int32_t> right,
+    std::span<std::byte> dst,
+    Encoding encoding,
+    uint32_t bit_depth);
+  static void store_stereo(std::span<const int64_t> left,
+    std::span<const int64_t> right,
+    std::span<std::byte> dst,
+    Encoding encoding,
+    uint32_t bit_depth);
+
+  // Runs a specific engine, an engine the CPU does not support falls back to Scalar
+  static void store_channel(std::span<const int32_t> src,
+    std::span<std::byte> dst,
+    size_t stride,
+    Encoding encoding,
+    uint32_t bit_depth,
+    Engine engine);
+  static void store_stereo(std::span<const int32_t> left,
+    std::span<const int32_t> right,
+    std::span<std::byte> dst,
+    Encoding encoding,
+    uint32_t bit_depth,
+    Engine engine);
+
+  // Fastest engine on this CPU, detected once
+  static Engine get_engine();
+};
+
+// A caller-owned PCM destination for num_channels channels. Interleaved buffers hold whole frames one after another;
+// planar ones hold one plane per channel, each data.size() / (num_channels * sample size) samples long.
+struct PcmBuffer
+{
+  std::span<std::byte> data;
+  PcmKernels::Encoding encoding;
+  bool interleaved;
+  uint32_t num_channels;
+
+  [[nodiscard]] size_t get_frame_capacity() const;
+};
+
+}// namespace flac
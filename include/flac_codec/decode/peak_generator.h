@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <flac_codec/decode/frame_decoder.h>
+#include <flac_codec/decode/parallel_flac_decoder.h>
+#include <string>
+#include <vector>
+
+namespace flac {
+
+// Extremes and RMS of one channel over one bucket, in sample units
+struct Peak
+{
+  int32_t m_min;
+  int32_t m_max;
+  float m_rms;
+};
+
+// Waveform overview, like the peak files audio editors keep next to a recording
+struct PeakOverview
+{
+  uint32_t m_num_channels{};
+  uint32_t m_bucket_size{};
+  uint64_t m_num_samples{};
+  // Bucket b of channel ch is at b * m_num_channels + ch; the last bucket may be shorter than m_bucket_size
+  std::vector<Peak> m_peaks;
+
+  // Little-endian: magic, channels and bucket size as uint32_t, samples and buckets as uint64_t, then every Peak as
+  // int32_t minimum, int32_t maximum and float RMS
+  void save(const std::string &file) const;
+};
+
+// Reduces each frame to peaks on the thread that decoded it, while the frame is still in cache, so the audio is never
+// held in full and never read twice
+class PeakGenerator
+{
+public:
+  // num_threads 0 uses every hardware thread
+  explicit PeakGenerator(const std::string &file_name,
+    ValidationLevel validation = ValidationLevel::Strict,
+    unsigned num_threads = 0);
+
+  // frame_step > 1 decodes only every frame_step-th frame for a quick, coarse overview; a bucket left without decoded
+  // samples repeats the bucket before it
+  PeakOverview generate(uint32_t bucket_size, unsigned frame_step = 1);
+
+private:
+  ParallelFlacDecoder m_decoder;
+};
+
+}// namespace flac
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <flac_codec/decode/flac_low_level_input.h>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flac {
+
+// Double-buffered file input: a background thread reads the next chunk while the bit reader consumes the current
+// one in place, so a refill only blocks when decoding outruns the disk
+class ReadAheadFileFlacInput final : public FlacLowLevelInput
+{
+public:
+  static const size_t DEFAULT_CHUNK_SIZE = 1U << 20U;
+
+  explicit ReadAheadFileFlacInput(const std::string &filename, size_t chunk_size = DEFAULT_CHUNK_SIZE);
+  ~ReadAheadFileFlacInput() override;
+
+  ReadAheadFileFlacInput(const ReadAheadFileFlacInput &) = delete;
+  ReadAheadFileFlacInput &operator=(const ReadAheadFileFlacInput &) = delete;
+  ReadAheadFileFlacInput(ReadAheadFileFlacInput &&) = delete;
+  ReadAheadFileFlacInput &operator=(ReadAheadFileFlacInput &&) = delete;
+
+  [[nodiscard]] size_t get_length() const override;
+  void seek_to(size_t pos) override;
+  void close() override;
+
+  // Takes effect from the next background read onwards
+  void set_chunk_size(size_t chunk_size);
+
+protected:
+  std::optional<uint64_t> read_underlying(std::vector<uint8_t> &buf, size_t off, size_t len) override;
+  std::span<const uint8_t> read_underlying_window() override;
+
+private:
+  int m_fd;
+  size_t m_file_length;
+
+  // m_buffers[m_front] is being consumed by the bit reader, the other one is owned by the worker while a fill is pending
+  std::array<std::vector<uint8_t>, 2> m_buffers;
+  size_t m_front;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  size_t m_chunk_size;
+  size_t m_fill_offset;
+  size_t m_fill_result;
+  std::exception_ptr m_fill_error;
+  bool m_fill_pending;
+  bool m_fill_done;
+  bool m_stop;
+  std::thread m_worker;
+
+  void worker_loop();
+  void request_fill(size_t offset);
+  size_t wait_fill();
+  size_t read_at(uint8_t *dst, size_t len, size_t offset) const;
+};
+
+}// namespace flac
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace flac {
+
+// A caller-owned int32_t destination that is written in place and never resized. Sample i of channel ch lives at
+// channels[ch][i * stride], so one layout covers separate per-channel spans and a single interleaved span.
+struct SampleBuffer
+{
+  static const size_t MAX_CHANNELS = 8;
+
+  std::array<int32_t *, MAX_CHANNELS> channels{};
+  size_t stride{};
+  size_t frame_capacity{};
+  uint32_t num_channels{};
+
+  // One span per channel, the capacity is that of the shortest
+  static SampleBuffer planar(std::span<const std::span<int32_t>> channels);
+  // Whole frames of num_channels samples one after another; a trailing partial frame is not used
+  static SampleBuffer interleaved(std::span<int32_t> data, uint32_t num_channels);
+};
+
+}// namespace flac
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <flac_codec/common/seek_table.h>
+#include <flac_codec/common/stream_info.h>
+#include <utility>
+#include <vector>
+
+namespace flac {
+
+// Decides how a seek reaches its target sample. Costs are in bytes of audio decoded: a seek to a new file position is
+// charged SEEK_COST on top of what is read there, and decoding forward is charged by the average frame size measured
+// so far. The decoder keeps a bracket of known frames around the target and probes inside it, at a position
+// interpolated from the bracket's bitrate, for as long as a probe is cheaper than decoding the rest of the gap.
+class SeekPlanner
+{
+public:
+  // Start of a frame; file offsets are absolute
+  struct Point
+  {
+    uint64_t m_sample_offset;
+    uint64_t m_file_offset;
+  };
+
+  // Roughly what a random read costs compared to decoding sequential bytes
+  static const uint64_t SEEK_COST = 16U << 10U;
+  // Bounds the probes of a single seek, bisection needs far fewer even on huge files
+  static const unsigned MAX_PROBES = 64;
+
+  SeekPlanner() = default;
+  SeekPlanner(const StreamInfo &info, const SeekTable *table, uint64_t audio_start, uint64_t file_length);
+
+  void record_frame(uint32_t frame_size, uint32_t block_size);
+
+  // Closest seek points at or before and after sample; the end of the file when there is none after it, with an
+  // unknown sample offset of UINT64_MAX if STREAMINFO does not give the stream length
+  [[nodiscard]] std::pair<Point, Point> get_bracket(uint64_t sample) const;
+  // Decoding from start to the frame holding sample, plus SEEK_COST when start is not the current input position
+  [[nodiscard]] uint64_t get_decode_cost(Point start, uint64_t sample, bool needs_seek) const;
+  // Probing for a frame closer to the target and decoding from it
+  [[nodiscard]] uint64_t get_probe_cost() const;
+  // Where to look for the frame holding sample; bisect ignores the bracket's bitrate and takes its middle
+  [[nodiscard]] uint64_t get_probe_offset(Point low, Point high, uint64_t sample, bool bisect) const;
+
+private:
+  std::vector<Point> m_points;// Valid seek points only, sorted by both offsets
+  uint64_t m_audio_start{};
+  uint64_t m_file_length{};
+  uint64_t m_num_samples{};
+  uint64_t m_block_size{};
+  // Measured frames; until there are any the averages come from the file size or STREAMINFO
+  uint64_t m_measured_bytes{};
+  uint64_t m_measured_samples{};
+  uint64_t m_measured_frames{};
+  uint64_t m_default_bytes{};
+  uint64_t m_default_samples{};
+
+  // Per sample, scaled so that integer division keeps sub-byte precision
+  [[nodiscard]] uint64_t get_scaled_bytes_per_sample() const;
+  [[nodiscard]] uint64_t get_average_frame_size() const;
+};
+
+}// namespace flac
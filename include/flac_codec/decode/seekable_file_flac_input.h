@@ -9,7 +9,7 @@
 
 namespace flac {
 
-class SeekableFileFlacInput : public FlacLowLevelInput
+class SeekableFileFlacInput final : public FlacLowLevelInput
 {
 private:
   std::fstream m_file_stream;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace flac {
+
+// Finds frame headers in raw bytes, without a bit reader or seeks. Sync codes are located with vector compares on the
+// code's two bytes at once, and each one is then checked the way FrameInfo::read_frame would: reserved values, the
+// coded frame or sample number and the CRC-8 over the header.
+class SyncKernels
+{
+public:
+  // Sync and codes, the longest coded number, 16-bit block size and sample rate, CRC-8
+  static const size_t MAX_HEADER_SIZE = 16;
+
+  enum class Engine : uint8_t {
+    Scalar,// memchr for the first byte of the code
+    Sse2,// 16 positions per compare, x86 only
+    Avx2,// 32 positions per compare, x86 only
+  };
+
+  // Appends to result the offset of every valid header that starts in data[0, end), in order. A header has to fit in
+  // data, so a caller splitting a buffer passes MAX_HEADER_SIZE - 1 bytes past end to not miss one cut off there.
+  static void find_headers(std::span<const uint8_t> data, size_t end, std::vector<size_t> &result);
+
+  // Runs a specific engine, an engine the CPU does not support falls back to a narrower one
+  static void find_headers(std::span<const uint8_t> data, size_t end, std::vector<size_t> &result, Engine engine);
+
+  // Whether data starts with a valid header
+  static bool is_header(std::span<const uint8_t> data);
+  // The coded frame number of a valid header at the start of data, or its sample number when the blocking strategy
+  // bit, the low bit of data[1], is set
+  static std::optional<uint64_t> get_header_position(std::span<const uint8_t> data);
+
+  // Fastest engine on this CPU, detected once
+  static Engine get_engine();
+};
+
+}// namespace flac
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/decode/pcm_kernels.h>
+#include <memory>
+#include <span>
+#include <string>
+
+namespace flac {
+
+// Streams interleaved PCM into a WAV file whose length is not known up front. The header reserves room for an RF64
+// ds64 chunk and is patched by finish(), which switches to RF64 once the file outgrows the 4 GB RIFF limit.
+// Decoders can format straight into the writer's buffer through get_buffer() and commit(), so PCM is never copied.
+class WavWriter
+{
+public:
+  enum class Mode : uint8_t {
+    Buffered,// Regular page-cached writes
+    Direct,// O_DIRECT, bypasses the page cache; falls back to Buffered where the file system does not support it
+  };
+
+  static const size_t DEFAULT_BUFFER_SIZE = 4U << 20U;
+
+  WavWriter(const std::string &filename,
+    uint32_t sample_rate,
+    uint32_t num_channels,
+    uint32_t bit_depth,
+    Mode mode = Mode::Buffered,
+    size_t buffer_size = DEFAULT_BUFFER_SIZE);
+  // Closes without patching the header unless finish() was called
+  ~WavWriter();
+
+  WavWriter(const WavWriter &) = delete;
+  WavWriter &operator=(const WavWriter &) = delete;
+  WavWriter(WavWriter &&) = delete;
+  WavWriter &operator=(WavWriter &&) = delete;
+
+  // Signed container for bit_depth bits: 16 bits up to 16, since 8-bit WAV is unsigned, then 24 and 32. Narrower
+  // depths are left-justified in it.
+  static PcmKernels::Encoding get_encoding(uint32_t bit_depth);
+
+  // Free space of the write buffer as whole frames, flushing first if fewer than min_frames are left
+  PcmBuffer get_buffer(size_t min_frames);
+  // Appends num_frames frames that were formatted into the last buffer returned by get_buffer()
+  void commit(size_t num_frames);
+  // Appends whole frames of already formatted PCM
+  void write(std::span<const std::byte> pcm);
+  // Writes out everything buffered and the final chunk sizes, then closes the file
+  void finish();
+
+  [[nodiscard]] uint64_t get_num_frames() const;
+
+private:
+  struct AlignedDelete
+  {
+    void operator()(std::byte *ptr) const;
+  };
+
+  int m_fd;
+  Mode m_mode;
+  uint32_t m_num_channels;
+  size_t m_frame_size;
+  PcmKernels::Encoding m_encoding;
+  std::unique_ptr<std::byte[], AlignedDelete> m_buffer;// NOLINT
+  size_t m_buffer_size;
+  size_t m_buffer_len;
+  size_t m_header_size;
+  uint64_t m_file_pos;
+  uint64_t m_num_frames;
+
+  void write_header(uint32_t sample_rate, uint32_t bit_depth);
+  void flush(bool all);
+  void write_fully(const std::byte *head, size_t head_len, const std::byte *tail, size_t tail_len);
+  void patch_header();
+  void close();
+};
+
+}// namespace flac
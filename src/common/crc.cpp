@@ -0,0 +1,182 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/common/crc.h>
+#include <span>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FLAC_CODEC_HAS_CLMUL 1
+#endif
+
+namespace flac {
+
+namespace {
+
+  // Entry [k][b] is the CRC of byte b followed by k zero bytes, so eight bytes are folded with eight lookups
+  template<typename T, size_t Width, uint32_t Poly> consteval std::array<std::array<T, 256>, 8> make_crc_tables()
+  {
+    std::array<std::array<T, 256>, 8> result{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      auto temp = i << (Width - 8U);
+      for (size_t j = 0; j < 8U; ++j) { temp = (temp << 1U) ^ ((temp >> (Width - 1U)) * Poly); }
+      result[0].at(i) = static_cast<T>(temp);
+    }
+    for (size_t k = 1; k < result.size(); ++k) {
+      for (size_t i = 0; i < 256; ++i) {
+        auto prev = static_cast<uint32_t>(result.at(k - 1).at(i));
+        auto next = Width == 8 ? result[0].at(prev) : (prev << 8U) ^ result[0].at(prev >> 8U);
+        result.at(k).at(i) = static_cast<T>(next);
+      }
+    }
+    return result;
+  }
+
+  constexpr auto CRC8_TABLES = make_crc_tables<uint8_t, 8, 0x107U>();
+  constexpr auto CRC16_TABLES = make_crc_tables<uint16_t, 16, 0x18005U>();
+
+  uint8_t crc8_table(uint8_t crc, const uint8_t *data, size_t len)
+  {
+    for (size_t i = 0; i < len; ++i) { crc = CRC8_TABLES[0][crc ^ data[i]]; }
+    return crc;
+  }
+
+  uint8_t crc8_slice8(uint8_t crc, const uint8_t *data, size_t len)
+  {
+    for (; len >= 8; data += 8, len -= 8) {
+      crc = static_cast<uint8_t>(CRC8_TABLES[7][crc ^ data[0]] ^ CRC8_TABLES[6][data[1]] ^ CRC8_TABLES[5][data[2]]
+                                 ^ CRC8_TABLES[4][data[3]] ^ CRC8_TABLES[3][data[4]] ^ CRC8_TABLES[2][data[5]]
+                                 ^ CRC8_TABLES[1][data[6]] ^ CRC8_TABLES[0][data[7]]);
+    }
+    return crc8_table(crc, data, len);
+  }
+
+  uint16_t crc16_table(uint16_t crc, const uint8_t *data, size_t len)
+  {
+    for (size_t i = 0; i < len; ++i) {
+      crc = static_cast<uint16_t>((crc << 8U) ^ CRC16_TABLES[0][(crc >> 8U) ^ data[i]]);
+    }
+    return crc;
+  }
+
+  uint16_t crc16_slice8(uint16_t crc, const uint8_t *data, size_t len)
+  {
+    // The running CRC lines up with the first two bytes of each word
+    for (; len >= 8; data += 8, len -= 8) {
+      crc = static_cast<uint16_t>(CRC16_TABLES[7][(crc >> 8U) ^ data[0]] ^ CRC16_TABLES[6][(crc & 0xFFU) ^ data[1]]
+                                  ^ CRC16_TABLES[5][data[2]] ^ CRC16_TABLES[4][data[3]] ^ CRC16_TABLES[3][data[4]]
+                                  ^ CRC16_TABLES[2][data[5]] ^ CRC16_TABLES[1][data[6]] ^ CRC16_TABLES[0][data[7]]);
+    }
+    return crc16_table(crc, data, len);
+  }
+
+#ifdef FLAC_CODEC_HAS_CLMUL
+  // x^n mod P for the CRC-16 polynomial, the folding constants
+  consteval uint64_t crc16_xpow_mod(size_t n)
+  {
+    uint32_t result = 1;
+    for (size_t i = 0; i < n; ++i) {
+      result <<= 1U;
+      if ((result & 0x10000U) != 0) { result ^= 0x18005U; }
+    }
+    return result;
+  }
+
+  __attribute__((target("pclmul,ssse3"))) inline __m128i load_block(const uint8_t *data)
+  {
+    // Byte-reverse so bit i of the 128-bit value is the coefficient of x^i within the block
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data)), reverse);// NOLINT
+  }
+
+  __attribute__((target("pclmul,ssse3"))) inline __m128i fold(__m128i acc, __m128i consts, __m128i block)
+  {
+    // acc * x^d mod P == hi(acc) * (x^(d+64) mod P) + lo(acc) * (x^d mod P); both products stay below 80 bits
+    return _mm_xor_si128(
+      _mm_xor_si128(_mm_clmulepi64_si128(acc, consts, 0x11), _mm_clmulepi64_si128(acc, consts, 0x00)), block);
+  }
+
+  // Folds 64 bytes per step in four independent lanes, then hands the remaining 128-bit residue to the table path.
+  // The residue is congruent to the message prefix modulo P, so its CRC continues the CRC of the whole prefix.
+  __attribute__((target("pclmul,ssse3"))) uint16_t crc16_clmul(uint16_t crc, const uint8_t *data, size_t len)
+  {
+    if (len < 64) { return crc16_slice8(crc, data, len); }
+
+    const __m128i fold512 = _mm_set_epi64x(static_cast<int64_t>(crc16_xpow_mod(512 + 64)),// NOLINT
+      static_cast<int64_t>(crc16_xpow_mod(512)));
+    const __m128i fold128 = _mm_set_epi64x(static_cast<int64_t>(crc16_xpow_mod(128 + 64)),// NOLINT
+      static_cast<int64_t>(crc16_xpow_mod(128)));
+
+    // A non-zero initial CRC is the same as XOR-ing it into the first 16 message bits
+    __m128i acc0 = _mm_xor_si128(load_block(data), _mm_set_epi64x(static_cast<int64_t>(uint64_t{ crc } << 48U), 0));
+    __m128i acc1 = load_block(data + 16);
+    __m128i acc2 = load_block(data + 32);
+    __m128i acc3 = load_block(data + 48);
+    data += 64;
+    len -= 64;
+
+    for (; len >= 64; data += 64, len -= 64) {
+      acc0 = fold(acc0, fold512, load_block(data));
+      acc1 = fold(acc1, fold512, load_block(data + 16));
+      acc2 = fold(acc2, fold512, load_block(data + 32));
+      acc3 = fold(acc3, fold512, load_block(data + 48));
+    }
+
+    __m128i acc = fold(acc0, fold128, acc1);
+    acc = fold(acc, fold128, acc2);
+    acc = fold(acc, fold128, acc3);
+    for (; len >= 16; data += 16, len -= 16) { acc = fold(acc, fold128, load_block(data)); }
+
+    std::array<uint8_t, 16> residue{};
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(residue.data()), _mm_shuffle_epi8(acc, reverse));// NOLINT
+    return crc16_table(crc16_slice8(0, residue.data(), residue.size()), data, len);
+  }
+
+  bool has_clmul()
+  {
+    static const bool supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+    return supported;
+  }
+#else
+  uint16_t crc16_clmul(uint16_t crc, const uint8_t *data, size_t len) { return crc16_slice8(crc, data, len); }
+
+  bool has_clmul() { return false; }
+#endif
+
+}// namespace
+
+uint8_t Crc::update_crc8(uint8_t crc, std::span<const uint8_t> data)
+{
+  return crc8_slice8(crc, data.data(), data.size());
+}
+
+uint16_t Crc::update_crc16(uint16_t crc, std::span<const uint8_t> data)
+{
+  static const Engine engine = get_crc16_engine();
+  if (engine == Engine::Clmul) { return crc16_clmul(crc, data.data(), data.size()); }
+  return crc16_slice8(crc, data.data(), data.size());
+}
+
+uint8_t Crc::update_crc8(uint8_t crc, std::span<const uint8_t> data, Engine engine)
+{
+  if (engine == Engine::Table) { return crc8_table(crc, data.data(), data.size()); }
+  return crc8_slice8(crc, data.data(), data.size());
+}
+
+uint16_t Crc::update_crc16(uint16_t crc, std::span<const uint8_t> data, Engine engine)
+{
+  switch (engine) {
+  case Engine::Table:
+    return crc16_table(crc, data.data(), data.size());
+  case Engine::Clmul:
+    if (has_clmul()) { return crc16_clmul(crc, data.data(), data.size()); }
+    return crc16_slice8(crc, data.data(), data.size());
+  default:
+    return crc16_slice8(crc, data.data(), data.size());
+  }
+}
+
+Crc::Engine Crc::get_crc16_engine() { return has_clmul() ? Engine::Clmul : Engine::Slice8; }
+
+}// namespace flac
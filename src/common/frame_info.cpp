@@ -2,8 +2,12 @@
 #include <cassert>
 #include <cstdint>
 #include <flac_codec/common/frame_info.h>
+#include <flac_codec/decode/byte_flac_input.h>
 #include <flac_codec/decode/data_format_exception.h>
 #include <flac_codec/decode/flac_low_level_input.h>
+#include <flac_codec/decode/mmap_flac_input.h>
+#include <flac_codec/decode/read_ahead_file_flac_input.h>
+#include <flac_codec/decode/seekable_file_flac_input.h>
 #include <optional>
 #include <stdexcept>
 #include <string>
@@ -17,7 +21,7 @@ FrameInfo::FrameInfo()
     m_bit_depth(std::nullopt), m_frame_size(std::nullopt)
 {}
 
-std::optional<FrameInfo> FrameInfo::read_frame(IFlacLowLevelInput &input)
+template<typename Input> std::optional<FrameInfo> FrameInfo::read_frame(Input &input)
 {
   input.reset_crcs();
   auto ttemp = input.read_byte();
@@ -70,10 +74,10 @@ std::optional<FrameInfo> FrameInfo::read_frame(IFlacLowLevelInput &input)
   return result;
 }
 
-std::optional<uint64_t> FrameInfo::read_utf8_integer(IFlacLowLevelInput &input)
+template<typename Input> std::optional<uint64_t> FrameInfo::read_utf8_integer(Input &input)
 {
   auto head = static_cast<uint8_t>(input.read_uint(8));
-  auto num_leading1s = std::countl_one(static_cast<uint32_t>(~(head << 24U)));// NOLINT
+  auto num_leading1s = std::countl_one(static_cast<uint32_t>(head) << 24U);
   assert(0 <= num_leading1s && num_leading1s <= 8);
   if (num_leading1s == 0) {
     return head;
@@ -93,7 +97,7 @@ std::optional<uint64_t> FrameInfo::read_utf8_integer(IFlacLowLevelInput &input)
   }
 }
 
-uint32_t FrameInfo::decode_block_size(uint8_t code, IFlacLowLevelInput &input)
+template<typename Input> uint32_t FrameInfo::decode_block_size(uint8_t code, Input &input)
 {
   if ((code >> 4U) != 0) {
     const std::string msg{ "code= " + std::to_string(static_cast<int>(code)) + ", is an invalid argument" };
@@ -119,7 +123,7 @@ uint32_t FrameInfo::decode_block_size(uint8_t code, IFlacLowLevelInput &input)
   }
 }
 
-std::optional<uint32_t> FrameInfo::decode_sample_rate(uint8_t code, IFlacLowLevelInput &input)
+template<typename Input> std::optional<uint32_t> FrameInfo::decode_sample_rate(uint8_t code, Input &input)
 {
   if ((code >> 4U) != 0) {
     const std::string msg{ "code= " + std::to_string(static_cast<int>(code))
@@ -243,7 +247,7 @@ std::optional<uint8_t> FrameInfo::search_first(const std::vector<std::vector<uin
   return std::nullopt;
 }
 
-std::optional<uint32_t> search_second(const std::vector<std::vector<uint32_t>> &table, uint32_t key)
+std::optional<uint32_t> FrameInfo::search_second(const std::vector<std::vector<uint32_t>> &table, uint32_t key)
 {
   for (const auto &pair : table) {
     if (pair[1] == key) { return pair[0]; }
@@ -251,4 +255,10 @@ std::optional<uint32_t> search_second(const std::vector<std::vector<uint32_t>> &
   return std::nullopt;
 }
 
+template std::optional<FrameInfo> FrameInfo::read_frame(IFlacLowLevelInput &input);
+template std::optional<FrameInfo> FrameInfo::read_frame(ByteFlacInput &input);
+template std::optional<FrameInfo> FrameInfo::read_frame(SeekableFileFlacInput &input);
+template std::optional<FrameInfo> FrameInfo::read_frame(MmapFlacInput &input);
+template std::optional<FrameInfo> FrameInfo::read_frame(ReadAheadFileFlacInput &input);
+
 }// namespace flac
@@ -15,7 +15,7 @@ SeekTable::SeekTable(std::span<const uint8_t> data)
     throw std::invalid_argument(msg);
   }
 
-  for (size_t i = 0; i < data.size(); ++i) {
+  for (size_t i = 0; i < data.size(); i += 18) {
     SeekPoint seek_point;
 
     seek_point.m_sample_offset = (uint64_t(data[i + 0]) << 56U) | (uint64_t(data[i + 1]) << 48U)
@@ -36,12 +36,13 @@ SeekTable::SeekTable(std::span<const uint8_t> data)
 
 void SeekTable::check_values() const
 {
-  for (size_t i = 0; i < m_points.size(); ++i) {
+  // Placeholders have the largest sample offset, so this also keeps them after every real point
+  for (size_t i = 1; i < m_points.size(); ++i) {
     const SeekPoint &p = m_points.at(i);// NOLINT
     if (p.m_sample_offset != UINT64_MAX) {
       const SeekPoint &q = m_points.at(i - 1);// NOLINT
       if (p.m_sample_offset <= q.m_sample_offset) { throw std::logic_error("Samples offsets out of order"); }
-      if (p.m_file_offset != q.m_file_offset) { throw std::logic_error("File offsets out of order"); }
+      if (p.m_file_offset < q.m_file_offset) { throw std::logic_error("File offsets out of order"); }
     }
   }
 }
@@ -44,7 +44,7 @@ StreamInfo::StreamInfo(const std::vector<uint8_t> &bytes)
       throw DataFormatException(msg);
     }
 
-    m_sample_rate = static_cast<uint32_t>(input.read_uint(3)) + 1;
+    m_sample_rate = static_cast<uint32_t>(input.read_uint(20));
     if (m_sample_rate == 0 || m_sample_rate > 655350) {
       const std::string msg{ "sample_rate= " + std::to_string(m_sample_rate)
                              + ", is equal to 0 OR is greater than 655350" };
@@ -54,6 +54,7 @@ StreamInfo::StreamInfo(const std::vector<uint8_t> &bytes)
     m_num_channels = static_cast<uint8_t>(input.read_uint(3) + 1);
     m_bit_depth = static_cast<uint16_t>(input.read_uint(5) + 1);
     m_num_samples = static_cast<uint64_t>(input.read_uint(18)) << 18U | static_cast<uint64_t>(input.read_uint(18));
+    m_md5_hash.resize(16);
     input.read_fully(m_md5_hash);
   } catch (const std::exception &e) {
     throw std::runtime_error(e.what());
@@ -0,0 +1,437 @@
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/decode/channel_kernels.h>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FLAC_CODEC_HAS_X86_SIMD 1
+#endif
+
+namespace flac {
+
+namespace {
+
+  using StereoMode = ChannelKernels::StereoMode;
+
+  struct Bounds
+  {
+    int64_t lower;
+    int64_t upper;
+  };
+
+  Bounds get_bounds(uint32_t bit_depth)
+  {
+    if (bit_depth < 1 || bit_depth > 32) { throw std::invalid_argument("bit_depth is invalid"); }
+    auto lower = -(int64_t{ 1 } << (bit_depth - 1U));// NOLINT
+    return { lower, -(lower + 1) };
+  }
+
+  // Arithmetic is done unsigned so that samples of a corrupt stream wrap instead of overflowing
+  template<StereoMode Mode, typename Sample>
+  inline void decorrelate(Sample first, Sample second, Sample &left, Sample &right)
+  {
+    using Unsigned = std::make_unsigned_t<Sample>;
+    auto a = static_cast<Unsigned>(first);
+    auto b = static_cast<Unsigned>(second);
+    if constexpr (Mode == StereoMode::LeftSide) {
+      left = first;
+      right = static_cast<Sample>(a - b);
+    } else if constexpr (Mode == StereoMode::SideRight) {
+      left = static_cast<Sample>(a + b);
+      right = second;
+    } else {
+      // The side channel keeps the bit that the mid channel dropped, so an arithmetic shift restores it exactly
+      auto r = static_cast<Unsigned>(a - static_cast<Unsigned>(second >> 1));// NOLINT
+      left = static_cast<Sample>(r + b);
+      right = static_cast<Sample>(r);
+    }
+  }
+
+  template<StereoMode Mode, bool Check, typename Sample>
+  bool store_stereo_scalar(const Sample *first,
+    const Sample *second,
+    Sample *left,
+    Sample *right,
+    size_t len,
+    Bounds bounds)
+  {
+    bool in_range = true;
+    for (size_t i = 0; i < len; ++i) {
+      decorrelate<Mode>(first[i], second[i], left[i], right[i]);
+      if constexpr (Check) {
+        in_range &= left[i] >= bounds.lower && left[i] <= bounds.upper;
+        in_range &= right[i] >= bounds.lower && right[i] <= bounds.upper;
+      }
+    }
+    return in_range;
+  }
+
+  template<bool Check, typename Sample>
+  bool store_channel_scalar(const Sample *src, Sample *dst, size_t len, Bounds bounds)
+  {
+    bool in_range = true;
+    for (size_t i = 0; i < len; ++i) {
+      dst[i] = src[i];
+      if constexpr (Check) { in_range &= src[i] >= bounds.lower && src[i] <= bounds.upper; }
+    }
+    return in_range;
+  }
+
+#ifdef FLAC_CODEC_HAS_X86_SIMD
+  // Lane-width dispatch for the vector kernels: int64_t samples take 2 or 4 lanes per vector, int32_t samples 4 or 8
+  template<typename Sample> __attribute__((target("sse4.2"))) inline __m128i set1(int64_t val)
+  {
+    if constexpr (sizeof(Sample) == 8) { return _mm_set1_epi64x(val); }
+    return _mm_set1_epi32(static_cast<int32_t>(val));
+  }
+
+  template<typename Sample> __attribute__((target("avx2"))) inline __m256i set1_256(int64_t val)
+  {
+    if constexpr (sizeof(Sample) == 8) { return _mm256_set1_epi64x(val); }
+    return _mm256_set1_epi32(static_cast<int32_t>(val));
+  }
+
+  template<typename Sample> __attribute__((target("sse4.2"))) inline __m128i add(__m128i a, __m128i b)
+  {
+    if constexpr (sizeof(Sample) == 8) { return _mm_add_epi64(a, b); }
+    return _mm_add_epi32(a, b);
+  }
+
+  template<typename Sample> __attribute__((target("avx2"))) inline __m256i add(__m256i a, __m256i b)
+  {
+    if constexpr (sizeof(Sample) == 8) { return _mm256_add_epi64(a, b); }
+    return _mm256_add_epi32(a, b);
+  }
+
+  template<typename Sample> __attribute__((target("sse4.2"))) inline __m128i sub(__m128i a, __m128i b)
+  {
+    if constexpr (sizeof(Sample) == 8) { return _mm_sub_epi64(a, b); }
+    return _mm_sub_epi32(a, b);
+  }
+
+  template<typename Sample> __attribute__((target("avx2"))) inline __m256i sub(__m256i a, __m256i b)
+  {
+    if constexpr (sizeof(Sample) == 8) { return _mm256_sub_epi64(a, b); }
+    return _mm256_sub_epi32(a, b);
+  }
+
+  // SSE and AVX2 have no 64-bit arithmetic shift, shifting by one only has to copy the sign bit back in
+  template<typename Sample> __attribute__((target("sse4.2"))) inline __m128i sra1(__m128i val)
+  {
+    if constexpr (sizeof(Sample) == 8) {
+      const __m128i sign = _mm_set1_epi64x(INT64_MIN);
+      return _mm_or_si128(_mm_srli_epi64(val, 1), _mm_and_si128(val, sign));
+    }
+    return _mm_srai_epi32(val, 1);
+  }
+
+  template<typename Sample> __attribute__((target("avx2"))) inline __m256i sra1(__m256i val)
+  {
+    if constexpr (sizeof(Sample) == 8) {
+      const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+      return _mm256_or_si256(_mm256_srli_epi64(val, 1), _mm256_and_si256(val, sign));
+    }
+    return _mm256_srai_epi32(val, 1);
+  }
+
+  template<typename Sample> __attribute__((target("sse4.2"))) inline __m128i cmpgt(__m128i a, __m128i b)
+  {
+    if constexpr (sizeof(Sample) == 8) { return _mm_cmpgt_epi64(a, b); }
+    return _mm_cmpgt_epi32(a, b);
+  }
+
+  template<typename Sample> __attribute__((target("avx2"))) inline __m256i cmpgt(__m256i a, __m256i b)
+  {
+    if constexpr (sizeof(Sample) == 8) { return _mm256_cmpgt_epi64(a, b); }
+    return _mm256_cmpgt_epi32(a, b);
+  }
+
+  template<StereoMode Mode, typename Sample>
+  __attribute__((target("sse4.2"))) inline void
+    decorrelate(__m128i first, __m128i second, __m128i &left, __m128i &right)
+  {
+    if constexpr (Mode == StereoMode::LeftSide) {
+      left = first;
+      right = sub<Sample>(first, second);
+    } else if constexpr (Mode == StereoMode::SideRight) {
+      left = add<Sample>(first, second);
+      right = second;
+    } else {
+      right = sub<Sample>(first, sra1<Sample>(second));
+      left = add<Sample>(right, second);
+    }
+  }
+
+  template<StereoMode Mode, typename Sample>
+  __attribute__((target("avx2"))) inline void decorrelate(__m256i first, __m256i second, __m256i &left, __m256i &right)
+  {
+    if constexpr (Mode == StereoMode::LeftSide) {
+      left = first;
+      right = sub<Sample>(first, second);
+    } else if constexpr (Mode == StereoMode::SideRight) {
+      left = add<Sample>(first, second);
+      right = second;
+    } else {
+      right = sub<Sample>(first, sra1<Sample>(second));
+      left = add<Sample>(right, second);
+    }
+  }
+
+  // Out-of-range lanes are OR-ed into a mask that is tested once at the end of the block
+  template<typename Sample>
+  __attribute__((target("sse4.2"))) inline __m128i out_of_range(__m128i val, __m128i lower, __m128i upper)
+  {
+    return _mm_or_si128(cmpgt<Sample>(val, upper), cmpgt<Sample>(lower, val));
+  }
+
+  template<typename Sample>
+  __attribute__((target("avx2"))) inline __m256i out_of_range(__m256i val, __m256i lower, __m256i upper)
+  {
+    return _mm256_or_si256(cmpgt<Sample>(val, upper), cmpgt<Sample>(lower, val));
+  }
+
+  template<StereoMode Mode, bool Check, typename Sample>
+  __attribute__((target("sse4.2"))) bool store_stereo_sse42(const Sample *first,
+    const Sample *second,
+    Sample *left,
+    Sample *right,
+    size_t len,
+    Bounds bounds)
+  {
+    constexpr size_t LANES = sizeof(__m128i) / sizeof(Sample);
+    const __m128i lower = set1<Sample>(bounds.lower);
+    const __m128i upper = set1<Sample>(bounds.upper);
+    __m128i bad = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + LANES <= len; i += LANES) {
+      auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + i));// NOLINT
+      auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(second + i));// NOLINT
+      __m128i l;
+      __m128i r;
+      decorrelate<Mode, Sample>(a, b, l, r);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(left + i), l);// NOLINT
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(right + i), r);// NOLINT
+      if constexpr (Check) {
+        bad = _mm_or_si128(
+          bad, _mm_or_si128(out_of_range<Sample>(l, lower, upper), out_of_range<Sample>(r, lower, upper)));
+      }
+    }
+    auto in_range = _mm_testz_si128(bad, bad) != 0;
+    return store_stereo_scalar<Mode, Check>(first + i, second + i, left + i, right + i, len - i, bounds) && in_range;
+  }
+
+  template<StereoMode Mode, bool Check, typename Sample>
+  __attribute__((target("avx2"))) bool store_stereo_avx2(const Sample *first,
+    const Sample *second,
+    Sample *left,
+    Sample *right,
+    size_t len,
+    Bounds bounds)
+  {
+    constexpr size_t LANES = sizeof(__m256i) / sizeof(Sample);
+    const __m256i lower = set1_256<Sample>(bounds.lower);
+    const __m256i upper = set1_256<Sample>(bounds.upper);
+    __m256i bad = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + LANES <= len; i += LANES) {
+      auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + i));// NOLINT
+      auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(second + i));// NOLINT
+      __m256i l;
+      __m256i r;
+      decorrelate<Mode, Sample>(a, b, l, r);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(left + i), l);// NOLINT
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(right + i), r);// NOLINT
+      if constexpr (Check) {
+        bad = _mm256_or_si256(
+          bad, _mm256_or_si256(out_of_range<Sample>(l, lower, upper), out_of_range<Sample>(r, lower, upper)));
+      }
+    }
+    auto in_range = _mm256_testz_si256(bad, bad) != 0;
+    return store_stereo_scalar<Mode, Check>(first + i, second + i, left + i, right + i, len - i, bounds) && in_range;
+  }
+
+  template<bool Check, typename Sample>
+  __attribute__((target("avx2"))) bool store_channel_avx2(const Sample *src, Sample *dst, size_t len, Bounds bounds)
+  {
+    constexpr size_t LANES = sizeof(__m256i) / sizeof(Sample);
+    const __m256i lower = set1_256<Sample>(bounds.lower);
+    const __m256i upper = set1_256<Sample>(bounds.upper);
+    __m256i bad = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + LANES <= len; i += LANES) {
+      auto val = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));// NOLINT
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), val);// NOLINT
+      if constexpr (Check) { bad = _mm256_or_si256(bad, out_of_range<Sample>(val, lower, upper)); }
+    }
+    auto in_range = _mm256_testz_si256(bad, bad) != 0;
+    return store_channel_scalar<Check>(src + i, dst + i, len - i, bounds) && in_range;
+  }
+
+  bool has_sse42()
+  {
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+  }
+
+  bool has_avx2()
+  {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+  }
+#else
+  bool has_sse42() { return false; }
+
+  bool has_avx2() { return false; }
+#endif
+
+  template<StereoMode Mode, bool Check, typename Sample>
+  bool store_stereo_with(ChannelKernels::Engine engine,
+    const Sample *first,
+    const Sample *second,
+    Sample *left,
+    Sample *right,
+    size_t len,
+    Bounds bounds)
+  {
+#ifdef FLAC_CODEC_HAS_X86_SIMD
+    if (engine == ChannelKernels::Engine::Avx2 && has_avx2()) {
+      return store_stereo_avx2<Mode, Check>(first, second, left, right, len, bounds);
+    }
+    if (engine != ChannelKernels::Engine::Scalar && has_sse42()) {
+      return store_stereo_sse42<Mode, Check>(first, second, left, right, len, bounds);
+    }
+#endif
+    return store_stereo_scalar<Mode, Check>(first, second, left, right, len, bounds);
+  }
+
+  template<StereoMode Mode, typename Sample>
+  bool store_stereo_with(ChannelKernels::Engine engine,
+    const Sample *first,
+    const Sample *second,
+    Sample *left,
+    Sample *right,
+    size_t len,
+    Bounds bounds,
+    bool check)
+  {
+    if (check) { return store_stereo_with<Mode, true>(engine, first, second, left, right, len, bounds); }
+    return store_stereo_with<Mode, false>(engine, first, second, left, right, len, bounds);
+  }
+
+  template<typename Sample>
+  bool store_stereo_samples(StereoMode mode,
+    std::span<const Sample> first,
+    std::span<const Sample> second,
+    std::span<Sample> left,
+    std::span<Sample> right,
+    uint32_t bit_depth,
+    bool check,
+    ChannelKernels::Engine engine)
+  {
+    auto len = first.size();
+    if (second.size() < len || left.size() < len || right.size() < len) {
+      throw std::invalid_argument("Channel buffers are too small");
+    }
+    auto bounds = get_bounds(bit_depth);
+
+    switch (mode) {
+    case StereoMode::LeftSide:
+      return store_stereo_with<StereoMode::LeftSide>(
+        engine, first.data(), second.data(), left.data(), right.data(), len, bounds, check);
+    case StereoMode::SideRight:
+      return store_stereo_with<StereoMode::SideRight>(
+        engine, first.data(), second.data(), left.data(), right.data(), len, bounds, check);
+    case StereoMode::MidSide:
+      return store_stereo_with<StereoMode::MidSide>(
+        engine, first.data(), second.data(), left.data(), right.data(), len, bounds, check);
+    default:
+      throw std::invalid_argument("Stereo mode is invalid");
+    }
+  }
+
+  template<typename Sample>
+  bool store_channel_samples(std::span<const Sample> src, std::span<Sample> dst, uint32_t bit_depth, bool check)
+  {
+    if (dst.size() < src.size()) { throw std::invalid_argument("Channel buffer is too small"); }
+    auto bounds = get_bounds(bit_depth);
+
+#ifdef FLAC_CODEC_HAS_X86_SIMD
+    if (has_avx2()) {
+      if (check) { return store_channel_avx2<true>(src.data(), dst.data(), src.size(), bounds); }
+      return store_channel_avx2<false>(src.data(), dst.data(), src.size(), bounds);
+    }
+#endif
+    if (check) { return store_channel_scalar<true>(src.data(), dst.data(), src.size(), bounds); }
+    return store_channel_scalar<false>(src.data(), dst.data(), src.size(), bounds);
+  }
+
+}// namespace
+
+bool ChannelKernels::store_stereo(StereoMode mode,
+  std::span<const int64_t> first,
+  std::span<const int64_t> second,
+  std::span<int64_t> left,
+  std::span<int64_t> right,
+  uint32_t bit_depth,
+  bool check)
+{
+  static const Engine engine = get_engine();
+  return store_stereo_samples(mode, first, second, left, right, bit_depth, check, engine);
+}
+
+bool ChannelKernels::store_stereo(StereoMode mode,
+  std::span<const int32_t> first,
+  std::span<const int32_t> second,
+  std::span<int32_t> left,
+  std::span<int32_t> right,
+  uint32_t bit_depth,
+  bool check)
+{
+  static const Engine engine = get_engine();
+  return store_stereo_samples(mode, first, second, left, right, bit_depth, check, engine);
+}
+
+bool ChannelKernels::store_stereo(StereoMode mode,
+  std::span<const int64_t> first,
+  std::span<const int64_t> second,
+  std::span<int64_t> left,
+  std::span<int64_t> right,
+  uint32_t bit_depth,
+  bool check,
+  Engine engine)
+{
+  return store_stereo_samples(mode, first, second, left, right, bit_depth, check, engine);
+}
+
+bool ChannelKernels::store_stereo(StereoMode mode,
+  std::span<const int32_t> first,
+  std::span<const int32_t> second,
+  std::span<int32_t> left,
+  std::span<int32_t> right,
+  uint32_t bit_depth,
+  bool check,
+  Engine engine)
+{
+  return store_stereo_samples(mode, first, second, left, right, bit_depth, check, engine);
+}
+
+bool ChannelKernels::store_channel(std::span<const int64_t> src, std::span<int64_t> dst, uint32_t bit_depth, bool check)
+{
+  return store_channel_samples(src, dst, bit_depth, check);
+}
+
+bool ChannelKernels::store_channel(std::span<const int32_t> src, std::span<int32_t> dst, uint32_t bit_depth, bool check)
+{
+  return store_channel_samples(src, dst, bit_depth, check);
+}
+
+ChannelKernels::Engine ChannelKernels::get_engine()
+{
+  if (has_avx2()) { return Engine::Avx2; }
+  return has_sse42() ? Engine::Sse42 : Engine::Scalar;
+}
+
+}// namespace flac
@@ -7,9 +7,17 @@
 #include <flac_codec/decode/data_format_exception.h>
 #include <flac_codec/decode/flac_decoder.h>
 #include <flac_codec/decode/frame_decoder.h>
+#include <flac_codec/decode/frame_index.h>
+#include <flac_codec/decode/frame_scanner.h>
+#include <flac_codec/decode/mmap_flac_input.h>
+#include <flac_codec/decode/read_ahead_file_flac_input.h>
+#include <flac_codec/decode/sample_buffer.h>
+#include <flac_codec/decode/seek_planner.h>
 #include <flac_codec/decode/seekable_file_flac_input.h>
+#include <flac_codec/decode/sync_kernels.h>
 #include <memory>
 #include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -17,9 +25,16 @@
 
 namespace flac {
 
-FlacDecoder::FlacDecoder(const std::string &file_name)
+FlacDecoder::FlacDecoder(const std::string &file_name, InputType input_type, ValidationLevel validation)
+  : m_input_type(input_type), m_validation(validation)
 {
-  m_input = std::make_unique<SeekableFileFlacInput>(file_name);
+  if (m_input_type == InputType::Mmap) {
+    m_input = std::make_unique<MmapFlacInput>(file_name);
+  } else if (m_input_type == InputType::ReadAhead) {
+    m_input = std::make_unique<ReadAheadFileFlacInput>(file_name);
+  } else {
+    m_input = std::make_unique<SeekableFileFlacInput>(file_name);
+  }
 
   if (static_cast<uint32_t>(m_input->read_uint(32)) != 0x664C6143) {
     throw DataFormatException("Invalid magic string");
@@ -30,7 +45,7 @@ FlacDecoder::FlacDecoder(const std::string &file_name)
 
 std::optional<std::pair<uint8_t, std::vector<uint8_t>>> FlacDecoder::read_and_handle_metadata_block()
 {
-  if (!m_metadata_end_pos.has_value()) { return std::nullopt; }
+  if (m_metadata_end_pos.has_value()) { return std::nullopt; }
 
   const bool last = m_input->read_uint(1) != 0;
   auto type = static_cast<uint8_t>(m_input->read_uint(7));
@@ -51,49 +66,193 @@ std::optional<std::pair<uint8_t, std::vector<uint8_t>>> FlacDecoder::read_and_ha
 
   if (last) {
     m_metadata_end_pos = m_input->get_position();
-    m_frame_dec = std::make_unique<FrameDecoder>(m_input, m_stream_info->m_bit_depth);
+    m_seek_planner = SeekPlanner(*m_stream_info, m_seek_table.get(), m_input->get_position(), m_input->get_length());
+    if (m_input_type == InputType::Mmap) {
+      create_frame_decoder<MmapFlacInput>();
+    } else if (m_input_type == InputType::ReadAhead) {
+      auto &input = static_cast<ReadAheadFileFlacInput &>(*m_input);
+      input.set_chunk_size(get_read_ahead_chunk_size(*m_stream_info));
+      create_frame_decoder<ReadAheadFileFlacInput>();
+    } else {
+      create_frame_decoder<SeekableFileFlacInput>();
+    }
   }
 
   return std::make_pair(type, data);
 }
 
+template<typename Input> void FlacDecoder::create_frame_decoder()
+{
+  if (m_validation == ValidationLevel::Trusted) {
+    create_frame_decoder<Input, ValidationLevel::Trusted>();
+  } else if (m_validation == ValidationLevel::Checked) {
+    create_frame_decoder<Input, ValidationLevel::Checked>();
+  } else {
+    create_frame_decoder<Input, ValidationLevel::Strict>();
+  }
+}
+
+template<typename Input, ValidationLevel Level> void FlacDecoder::create_frame_decoder()
+{
+  auto &input = static_cast<Input &>(*m_input);
+  auto bit_depth = m_stream_info->m_bit_depth;
+  // The side channel of a stereo frame has one more bit than the stream, so only 32-bit streams need 64-bit samples
+  if (bit_depth <= 31) {
+    m_frame_dec = std::make_unique<FrameDecoder<Input, Level, int32_t>>(input, bit_depth);
+  } else {
+    m_frame_dec = std::make_unique<FrameDecoder<Input, Level, int64_t>>(input, bit_depth);
+  }
+  m_frame_dec->set_channel_mask(m_channel_mask);
+}
+
+size_t FlacDecoder::get_read_ahead_chunk_size(const StreamInfo &info)
+{
+  // Enough for several of the largest frames per refill; the frame size is optional in STREAMINFO
+  const size_t frames_per_chunk = 32;
+  const size_t min_chunk_size = 256U << 10U;
+  if (info.m_max_frame_size == 0) { return ReadAheadFileFlacInput::DEFAULT_CHUNK_SIZE; }
+  return std::max(min_chunk_size, size_t(info.m_max_frame_size) * frames_per_chunk);
+}
+
 uint32_t FlacDecoder::read_audio_block(Samples &samples, size_t offset)
+{
+  return read_audio_block_into(samples, offset);
+}
+
+uint32_t FlacDecoder::read_audio_block(Samples32 &samples, size_t offset)
+{
+  return read_audio_block_into(samples, offset);
+}
+
+uint32_t FlacDecoder::read_audio_block(const PcmBuffer &out, size_t offset)
+{
+  return read_audio_block_into(out, offset);
+}
+
+uint32_t FlacDecoder::read_audio_block(const SampleBuffer &out, size_t offset)
+{
+  return read_audio_block_into(out, offset);
+}
+
+size_t FlacDecoder::read_audio_blocks(const SampleBuffer &out)
+{
+  if (m_frame_dec == nullptr) { throw std::runtime_error("Metadata blocks not fully consumed yet"); }
+
+  size_t written = 0;
+  while (written < out.frame_capacity) {
+    // Headers are only parsed twice once the space left may be too small, so a full-size buffer never seeks back
+    auto space = out.frame_capacity - written;
+    if (space < m_stream_info->m_max_block_size || m_stream_info->m_max_block_size == 0) {
+      auto block_size = peek_block_size();
+      if (!block_size.has_value() || block_size.value() > space) { break; }
+    }
+
+    auto frame = m_frame_dec->read_frame(out, written);
+    if (!frame.has_value()) { break; }
+    record_frame(frame.value());
+    written += frame.value().m_block_size.value_or(0);
+  }
+  return written;
+}
+
+std::optional<FrameLocation> FlacDecoder::skim_audio_block()
+{
+  if (m_frame_dec == nullptr) { throw std::runtime_error("Metadata blocks not fully consumed yet"); }
+
+  auto pos = m_input->get_position();
+  auto frame = m_frame_dec->skim_frame(m_stream_info->m_max_frame_size);
+  if (!frame.has_value()) { return std::nullopt; }
+  record_frame(frame.value());
+  return FrameLocation{ pos, get_sample_offset(frame.value()), frame.value().m_block_size.value_or(0) };
+}
+
+std::optional<uint32_t> FlacDecoder::peek_block_size()
+{
+  if (m_frame_dec == nullptr) { throw std::runtime_error("Metadata blocks not fully consumed yet"); }
+
+  auto pos = m_input->get_position();
+  auto frame = FrameInfo::read_frame(*m_input);
+  m_input->seek_to(pos);
+  if (!frame.has_value()) { return std::nullopt; }
+  return frame.value().m_block_size.value_or(0);
+}
+
+template<typename Output> uint32_t FlacDecoder::read_audio_block_into(Output &out, size_t offset)
 {
   if (m_frame_dec == nullptr) { throw std::runtime_error("Metadata blocks not fully consumed yet"); }
 
-  auto frame = m_frame_dec->read_frame(samples, offset);
+  auto frame = m_frame_dec->read_frame(out, offset);
 
   if (!frame.has_value()) {
     return 0;
   } else {
+    record_frame(frame.value());
     return frame.value().m_block_size.value_or(0);
   }
 }
 
 uint32_t FlacDecoder::seek_and_read_audio_block(uint64_t pos, Samples &samples, size_t offset)
+{
+  return seek_and_read_audio_block_into(pos, samples, offset);
+}
+
+uint32_t FlacDecoder::seek_and_read_audio_block(uint64_t pos, Samples32 &samples, size_t offset)
+{
+  return seek_and_read_audio_block_into(pos, samples, offset);
+}
+
+template<typename Output>
+uint32_t FlacDecoder::seek_and_read_audio_block_into(uint64_t pos, Output &samples, size_t offset)
 {
   if (m_frame_dec == nullptr) { throw std::runtime_error("Metadata blocks not fully consumed yet"); }
 
-  auto sample_and_file_pos = get_best_seek_point(pos);
-  if (pos - sample_and_file_pos.first > 300'000) {
-    sample_and_file_pos = seek_by_sync_and_decode(pos);
-    sample_and_file_pos.second -= m_metadata_end_pos.value_or(0);
+  // Same split as create_frame_decoder, so the frames skipped over are stored without widening
+  if (m_stream_info->m_bit_depth <= 31) {
+    return seek_and_read_audio_block_via(pos, m_seek_scratch32, samples, offset);
+  }
+  return seek_and_read_audio_block_via(pos, m_seek_scratch, samples, offset);
+}
+
+template<typename Scratch, typename Output>
+uint32_t FlacDecoder::seek_and_read_audio_block_via(uint64_t pos, Scratch &scratch, Output &samples, size_t offset)
+{
+  SeekPlanner::Point start{};
+  if (m_frame_index.has_value()) {
+    // The index lands on the frame holding pos, so the loop below decodes exactly one frame
+    auto frame = m_frame_index->find(pos);
+    if (!frame.has_value()) { return 0; }
+    start = { frame->m_sample_offset, frame->m_file_offset };
+  } else {
+    start = plan_seek(pos);
   }
-  m_input->seek_to(sample_and_file_pos.second + m_metadata_end_pos.value_or(0));
+  if (start.m_file_offset != m_input->get_position()) { m_input->seek_to(start.m_file_offset); }
 
-  uint64_t curr_pos = sample_and_file_pos.first;
-  Samples smpl(m_stream_info->m_num_channels, std::vector<int64_t>(65536));
+  // Frames before the target, and a target frame that starts before pos, are decoded into scratch space that lives as
+  // long as the decoder; a target frame that starts at pos goes straight into samples
+  if (scratch.empty()) {
+    scratch.assign(m_stream_info->m_num_channels, typename Scratch::value_type(m_stream_info->m_max_block_size));
+  }
 
+  uint64_t curr_pos = start.m_sample_offset;
   while (true) {
-    auto tframe = m_frame_dec->read_frame(smpl, 0);
+    if (curr_pos == pos) {
+      auto frame = m_frame_dec->read_frame(samples, offset);
+      if (!frame.has_value()) { return 0; }
+      record_frame(frame.value());
+      return frame.value().m_block_size.value_or(0);
+    }
+
+    auto tframe = m_frame_dec->read_frame(scratch, 0);
     if (!tframe.has_value()) { return 0; }
     auto frame = tframe.value();
+    record_frame(frame);
 
     const uint64_t next_pos = curr_pos + frame.m_block_size.value_or(0);
     if (next_pos > pos) {
-      for (size_t ch = 0; ch < smpl.size(); ++ch) {
-        std::copy(smpl[ch].begin() + long(pos - curr_pos),
-          smpl[ch].begin() + long(next_pos - pos),
+      for (size_t ch = 0; ch < scratch.size(); ++ch) {
+        if (((m_channel_mask >> ch) & 1U) == 0) { continue; }
+        std::copy(scratch[ch].begin() + long(pos - curr_pos),
+          scratch[ch].begin() + long(next_pos - curr_pos),
           samples[ch].begin() + long(offset));
       }
       return static_cast<uint32_t>(next_pos - pos);
@@ -103,77 +262,116 @@ uint32_t FlacDecoder::seek_and_read_audio_block(uint64_t pos, Samples &samples,
   }
 }
 
-std::pair<uint64_t, uint64_t> FlacDecoder::get_best_seek_point(uint64_t pos) const
-{
-  uint64_t sample_pos = 0;
-  uint64_t file_pos = 0;
-  if (m_seek_table != nullptr) {
-    for (const SeekTable::SeekPoint point : m_seek_table->m_points) {
-      if (point.m_sample_offset <= pos) {
-        sample_pos = point.m_sample_offset;
-        file_pos = point.m_file_offset;
-      } else {
-        break;
-      }
-    }
-  }
+std::optional<uint64_t> FlacDecoder::get_metadata_end_pos() const { return m_metadata_end_pos; }
 
-  return { sample_pos, file_pos };
+void FlacDecoder::set_frame_index(FrameIndex index) { m_frame_index = std::move(index); }
+
+void FlacDecoder::set_channel_mask(uint8_t mask)
+{
+  m_channel_mask = mask;
+  if (m_frame_dec != nullptr) { m_frame_dec->set_channel_mask(mask); }
 }
 
-std::pair<uint64_t, uint64_t> FlacDecoder::seek_by_sync_and_decode(uint64_t pos)
+SeekPlanner::Point FlacDecoder::plan_seek(uint64_t pos)
 {
-  uint64_t start = m_metadata_end_pos.value_or(0);
-  uint64_t end = m_input->get_length();
+  auto [low, high] = m_seek_planner.get_bracket(pos);
+  // Decoding on from the current position saves a seek, worth it for short skips forward
+  auto current = get_current_point();
+  if (current.has_value() && current->m_sample_offset > pos) { current = std::nullopt; }
 
-  while (end - start > 100'000) {
-    const uint64_t mid = (start + end) >> 1U;
-    auto offsets = get_next_frame_offsets(mid);
-    if (!offsets.has_value() || offsets.value().first > pos) {
-      end = mid;
+  // Cheapest known frame to decode from, with its cost
+  auto get_best_start = [&] {
+    auto cost = m_seek_planner.get_decode_cost(low, pos, true);
+    if (current.has_value()) {
+      auto current_cost = m_seek_planner.get_decode_cost(current.value(), pos, false);
+      if (current_cost <= cost) { return std::make_pair(current.value(), current_cost); }
+    }
+    return std::make_pair(low, cost);
+  };
+
+  bool bisect = false;
+  for (unsigned probes = 0; probes < SeekPlanner::MAX_PROBES; ++probes) {
+    if (get_best_start().second <= m_seek_planner.get_probe_cost() || high.m_file_offset - low.m_file_offset < 2) {
+      break;
+    }
+
+    auto span = high.m_file_offset - low.m_file_offset;
+    auto offset = m_seek_planner.get_probe_offset(low, high, pos, bisect);
+    auto frame = get_next_frame_offsets(offset);
+    if (!frame.has_value() || frame->second >= high.m_file_offset) {
+      // No frame starts in [offset, high), so the one holding pos starts before offset
+      high.m_file_offset = offset;
+    } else if (frame->first <= low.m_sample_offset || frame->first >= high.m_sample_offset) {
+      // A sync pattern inside audio data that passed the header CRC, or a frame out of order
+      break;
+    } else if (frame->first <= pos) {
+      low = { frame->first, frame->second };
     } else {
-      start = offsets.value().second;
+      high = { frame->first, frame->second };
     }
+    // Interpolation misses on bursts of bitrate; halving guarantees progress until it works again
+    bisect = (high.m_file_offset - low.m_file_offset) * 2 > span;
+  }
+  return get_best_start().first;
+}
+
+std::optional<SeekPlanner::Point> FlacDecoder::get_current_point()
+{
+  auto pos = m_input->get_position();
+  if (pos < m_metadata_end_pos.value_or(0)) { return std::nullopt; }
+  try {
+    auto frame = FrameInfo::read_frame(*m_input);
+    m_input->seek_to(pos);
+    if (!frame.has_value()) { return std::nullopt; }
+    return SeekPlanner::Point{ get_sample_offset(frame.value()), pos };
+  } catch (const std::runtime_error &) {
+    m_input->seek_to(pos);
+    return std::nullopt;
   }
+}
 
-  return get_next_frame_offsets(start).value_or({});
+void FlacDecoder::record_frame(const FrameInfo &frame)
+{
+  m_seek_planner.record_frame(frame.m_frame_size.value_or(0), frame.m_block_size.value_or(0));
 }
 
 std::optional<std::pair<uint64_t, uint64_t>> FlacDecoder::get_next_frame_offsets(uint64_t file_pos)
 {
-  if (file_pos < m_metadata_end_pos.value_or(0) || file_pos > m_input->get_length()) {
+  auto length = m_input->get_length();
+  if (file_pos < m_metadata_end_pos.value_or(0) || file_pos > length) {
     throw std::invalid_argument("File position out of bounds");
   }
 
-  while (true) {
-    m_input->seek_to(file_pos);
-
-    int state = 0;
-    while (true) {
-      auto byte = m_input->read_byte();
-      if (!byte.has_value()) {
-        return std::nullopt;
-      } else if (static_cast<int>(byte.value()) == 0xFF) {
-        state = 1;
-      } else if (state == 1 && (byte.value() & 0xFEU) == 0xF8) {
-        break;
-      } else {
-        state = 0;
-      }
+  // A few typical frames, probes mostly land within one of the next header. Chunks overlap by a header so that none is
+  // cut off between two of them.
+  const uint64_t sync_chunk_size = 16U << 10U;
+  while (file_pos < length) {
+    auto chunk_size = std::min<uint64_t>(sync_chunk_size, length - file_pos);
+    auto read_size = std::min<uint64_t>(chunk_size + SyncKernels::MAX_HEADER_SIZE - 1, length - file_pos);
+    std::span<const uint8_t> data;
+    if (m_input_type == InputType::Mmap) {
+      data = static_cast<MmapFlacInput &>(*m_input).get_data().subspan(file_pos, read_size);
+    } else {
+      m_input->seek_to(file_pos);
+      m_sync_scratch.resize(read_size);
+      m_input->read_fully(m_sync_scratch);
+      data = m_sync_scratch;
     }
 
-    file_pos = m_input->get_position() - 2;
-    m_input->seek_to(file_pos);
-
-    try {
-      auto tframe = FrameInfo::read_frame(*m_input);
-      if (!tframe.has_value()) { return {}; };
-      auto frame = tframe.value();
-      return std::make_pair(get_sample_offset(frame), file_pos);
-    } catch (const DataFormatException &e) {
-      file_pos += 2;
+    m_sync_offsets.clear();
+    SyncKernels::find_headers(data, chunk_size, m_sync_offsets);
+    for (const size_t offset : m_sync_offsets) {
+      m_input->seek_to(file_pos + offset);
+      try {
+        auto frame = FrameInfo::read_frame(*m_input);
+        if (frame.has_value()) { return std::make_pair(get_sample_offset(frame.value()), file_pos + offset); }
+      } catch (const std::runtime_error &) {
+        // Checked the same way already, only a header the kernels and FrameInfo disagree on gets here
+      }
     }
+    file_pos += chunk_size;
   }
+  return std::nullopt;
 }
 
 uint64_t FlacDecoder::get_sample_offset(FrameInfo &frame) const
@@ -1,10 +1,15 @@
 #include "flac_codec/decode/data_format_exception.h"
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <flac_codec/common/crc.h>
 #include <flac_codec/decode/flac_low_level_input.h>
 #include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -12,17 +17,64 @@
 
 namespace flac {
 
+namespace {
+
+  const size_t RICE_DECODING_TABLE_BITS = 13;
+  const size_t RICE_DECODING_TABLE_MASK = (1U << RICE_DECODING_TABLE_BITS) - 1U;
+  const size_t RICE_DECODING_CHUNK = 4;
+  // A code is at least param + 1 bits long, so larger parameters never fit in the table window
+  const size_t RICE_DECODING_TABLE_PARAMS = RICE_DECODING_TABLE_BITS;
+  // From this parameter on, codes rarely fit the table window and the count-leading-zeros engine is used instead
+  const size_t RICE_CLZ_MIN_PARAM = 8;
+  static_assert(RICE_CLZ_MIN_PARAM <= RICE_DECODING_TABLE_PARAMS);
+
+  template<typename T>
+  using RiceDecodingTables = std::array<std::array<T, 1U << RICE_DECODING_TABLE_BITS>, RICE_DECODING_TABLE_PARAMS>;
+
+  struct RiceDecodingTableSet
+  {
+    RiceDecodingTables<uint8_t> consumed;
+    RiceDecodingTables<int16_t> values;
+  };
+
+  // Maps the next RICE_DECODING_TABLE_BITS of input to the number of bits the first code uses (0 if it does not fit)
+  // and its decoded value, for every parameter that can have such short codes
+  consteval RiceDecodingTableSet make_rice_decoding_tables()
+  {
+    RiceDecodingTableSet result{};
+    for (size_t param = 0; param < RICE_DECODING_TABLE_PARAMS; ++param) {
+      for (size_t i = 0;; ++i) {
+        auto num_bits = (i >> param) + 1 + param;
+        if (num_bits > RICE_DECODING_TABLE_BITS) { break; }
+        auto bits = ((1U << param) | (i & ((1U << param) - 1U)));
+        auto shift = RICE_DECODING_TABLE_BITS - num_bits;
+        for (size_t j = 0; j < (1U << shift); j++) {
+          result.consumed.at(param).at((bits << shift) | j) = static_cast<uint8_t>(num_bits);
+          result.values.at(param).at((bits << shift) | j) =
+            static_cast<int16_t>(static_cast<int64_t>(i >> 1U) ^ -static_cast<int64_t>(i & 1U));
+        }
+      }
+      if (result.consumed.at(param).at(0) != 0) { throw std::logic_error("Assertion error"); }
+    }
+    return result;
+  }
+
+  constexpr RiceDecodingTableSet RICE_DECODING_TABLES = make_rice_decoding_tables();
+
+}// namespace
+
 FlacLowLevelInput::FlacLowLevelInput()// NOLINT
 {
-  m_byte_buffer.reserve(4096);
+  m_byte_buffer.resize(4096);
   position_changed(0);
-  initialize_tables();
-  initialize_crcs();
+  m_crc8 = 0;
+  m_crc16 = 0;
+  m_crc8_finished = false;
 }
 
 size_t FlacLowLevelInput::get_position() const
 {
-  return (m_byte_buffer_start_pos + m_byte_buffer_index - (m_bit_buffer_len + 7U)) / 8U;
+  return m_byte_buffer_start_pos + m_byte_buffer_index - (m_bit_buffer_len + 7U) / 8U;
 }
 
 size_t FlacLowLevelInput::get_bit_position() const
@@ -33,7 +85,7 @@ size_t FlacLowLevelInput::get_bit_position() const
 void FlacLowLevelInput::position_changed(size_t pos)
 {
   m_byte_buffer_start_pos = pos;
-  std::ranges::fill(m_byte_buffer, 0);
+  m_byte_data = m_byte_buffer.data();
   m_byte_buffer_len = 0;
   m_byte_buffer_index = 0;
   m_bit_buffer = 0;
@@ -46,59 +98,46 @@ void FlacLowLevelInput::check_byte_aligned() const
   if (m_bit_buffer_len % 8 != 0) { throw std::runtime_error("Not at a byte boundary"); }
 }
 
-int64_t FlacLowLevelInput::read_uint(size_t num_of_bits)
+void FlacLowLevelInput::read_rice_signed_ints(size_t param, std::vector<int64_t> &result, size_t start, size_t end)
 {
-  if (num_of_bits > 32) {
-    const std::string msg{ "num_of_bits= " + std::to_string(num_of_bits) + ", is greater than 32" };
-    throw std::invalid_argument(msg);
-  }
-
-  while (m_bit_buffer_len < num_of_bits) {
-    auto tbyte = read_underlying();
-    if (tbyte == std::nullopt) { throw std::runtime_error("Reached EOF"); }
-    auto byte = tbyte.value();
-
-    m_bit_buffer = (m_bit_buffer << 8U) | byte;
-    m_bit_buffer_len += 8U;
-    assert(m_bit_buffer_len <= 64U);
-  }
-
-  auto result = m_bit_buffer >> (m_bit_buffer_len - num_of_bits);
-  if (num_of_bits != 32) {
-    result &= (1U << num_of_bits) - 1U;
-    assert((result >> num_of_bits) == 0U);
-    m_bit_buffer_len -= num_of_bits;
-    assert(m_bit_buffer_len <= 64U);
-    return static_cast<uint32_t>(result);
-  } else {
-    m_bit_buffer_len -= num_of_bits;
-    assert(m_bit_buffer_len <= 64U);
-    return static_cast<int32_t>(result);
-  }
+  read_rice_signed_ints_of(param, result, start, end);
 }
 
-int32_t FlacLowLevelInput::read_signed_int(size_t num_of_bits)
+void FlacLowLevelInput::read_rice_signed_ints(size_t param, std::vector<int32_t> &result, size_t start, size_t end)
 {
-  auto shift = 32U - num_of_bits;
-  return static_cast<int32_t>(read_uint(num_of_bits) << shift) >> shift;// NOLINT
+  read_rice_signed_ints_of(param, result, start, end);
 }
 
-void FlacLowLevelInput::read_rice_signed_ints(size_t param, std::vector<int64_t> &result, size_t start, size_t end)
+template<typename T>
+void FlacLowLevelInput::read_rice_signed_ints_of(size_t param, std::vector<T> &result, size_t start, size_t end)
 {
   if (param > 31) {
     const std::string msg{ "param= " + std::to_string(param) + ", is greater than 32" };
     throw std::invalid_argument(msg);
   }
+  if (start > end || end > result.size()) { throw std::invalid_argument("Residual range is out of bounds"); }
 
-  auto unary_limit = 1UL << (53U - param);
+  // The tables only pay off while most codes fit their window, which stops happening as the parameter grows
+  if (param < RICE_CLZ_MIN_PARAM) {
+    read_rice_signed_ints_table(param, result, start, end);
+  } else {
+    read_rice_signed_ints_clz(param, result, start, end);
+  }
+}
 
-  auto &consume_table = RICE_DECODING_CONSUMED_TABLES.at(param);
-  auto &value_table = RICE_DECODING_VALUE_TABLES.at(param);
+template<typename T>
+void FlacLowLevelInput::read_rice_signed_ints_table(size_t param,
+  std::vector<T> &result,
+  size_t start,
+  size_t end)
+{
+  const auto &consume_table = RICE_DECODING_TABLES.consumed.at(param);
+  const auto &value_table = RICE_DECODING_TABLES.values.at(param);
 
   while (true) {
-    while (start <= end - RICE_DECODING_CHUNK) {
+    while (start + RICE_DECODING_CHUNK <= end) {
       if (m_bit_buffer_len < RICE_DECODING_CHUNK * RICE_DECODING_TABLE_BITS) {
-        if (m_byte_buffer_index <= m_byte_buffer_len.value_or(0) - 8) {
+        if (m_byte_buffer_index + 8 <= m_byte_buffer_len.value_or(0)) {
           fill_bit_buffer();
         } else {
           break;
@@ -108,50 +147,97 @@ void FlacLowLevelInput::read_rice_signed_ints(size_t param, std::vector<int64_t>
       for (size_t i = 0; i < RICE_DECODING_CHUNK; i++, start++) {
         auto extracted_bits =
           (m_bit_buffer >> (m_bit_buffer_len - RICE_DECODING_TABLE_BITS)) & RICE_DECODING_TABLE_MASK;
-        auto consumed = consume_table.at(extracted_bits);
+        auto consumed = consume_table[extracted_bits];
         if (static_cast<int>(consumed) == 0) { goto middle; }
         m_bit_buffer_len -= static_cast<size_t>(consumed);
-        result.at(start) = value_table.at(extracted_bits);
+        result[start] = value_table[extracted_bits];
       }
     }
 
   middle:
     if (start >= end) { break; }
-    size_t val = 0;
-    while (read_uint(1) == 0) {
-      if (val >= unary_limit) { throw DataFormatException("Residual value too large"); }
-      val++;
-    }
-    val = (val << param) | static_cast<uint32_t>(read_uint(param));
-    assert((val >> 53U) == 0);
-    val = (val >> 1U) ^ -(val & 1U);
-    assert((val >> 52U) == 0);
-    result.at(start) = static_cast<int64_t>(val);
+    auto val = read_rice_code(param);
+    result[start] = static_cast<T>((val >> 1U) ^ -(val & 1U));
     start++;
   }
 }
 
-void FlacLowLevelInput::fill_bit_buffer()
+template<typename T>
+void FlacLowLevelInput::read_rice_signed_ints_clz(size_t param, std::vector<T> &result, size_t start, size_t end)
 {
-  auto iidx = m_byte_buffer_index;
-  auto nidx = std::min((64 - m_bit_buffer_len) >> 3U, m_byte_buffer_len.value_or(0) - iidx);
-  auto bytes = m_byte_buffer;
+  const uint64_t low_mask = (uint64_t{ 1 } << param) - 1U;
+
+  for (; start < end; ++start) {
+    if (m_bit_buffer_len <= 56 && m_byte_buffer_index + 8 <= m_byte_buffer_len.value_or(0)) { fill_bit_buffer(); }
+
+    // Left-align the buffered bits: the leading zero count is the quotient and the low bits follow the stop bit
+    uint64_t val = 0;
+    const uint64_t window = m_bit_buffer_len == 0 ? 0 : m_bit_buffer << (64U - m_bit_buffer_len);
+    const auto quotient = static_cast<size_t>(std::countl_zero(window));
+    if (quotient + 1 + param <= m_bit_buffer_len) {
+      m_bit_buffer_len -= quotient + 1 + param;
+      val = (uint64_t{ quotient } << param) | ((m_bit_buffer >> m_bit_buffer_len) & low_mask);
+    } else {
+      val = read_rice_code(param);
+    }
+    result[start] = static_cast<T>((val >> 1U) ^ -(val & 1U));
+  }
+}
+
+// Decodes one code whose unary run may span several refills, returns the zigzag-encoded value
+uint64_t FlacLowLevelInput::read_rice_code(size_t param)
+{
+  auto unary_limit = uint64_t{ 1 } << (53U - param);
+
+  uint64_t quotient = 0;
+  while (true) {
+    if (m_bit_buffer_len == 0) { fill_bit_buffer(); }
+    const uint64_t window = m_bit_buffer << (64U - m_bit_buffer_len);
+    if (window == 0) {
+      quotient += m_bit_buffer_len;
+      m_bit_buffer_len = 0;
+    } else {
+      auto zeros = static_cast<size_t>(std::countl_zero(window));
+      quotient += zeros;
+      m_bit_buffer_len -= zeros + 1;
+      break;
+    }
+    if (quotient >= unary_limit) { throw DataFormatException("Residual value too large"); }
+  }
+  if (quotient >= unary_limit) { throw DataFormatException("Residual value too large"); }
+
+  auto val = (quotient << param) | static_cast<uint32_t>(read_uint(param));
+  assert((val >> 53U) == 0);
+  return val;
+}
 
-  if (nidx > 0) {
-    for (size_t jidx = 0; jidx < nidx; jidx++, iidx++) {
-      m_bit_buffer = (m_bit_buffer << 8U) | (bytes.at(iidx) & 0xFFU);
+void FlacLowLevelInput::fill_bit_buffer()
+{
+  assert(m_bit_buffer_len <= 56);
+  auto num_bytes = (64U - m_bit_buffer_len) >> 3U;
+
+  if (m_byte_buffer_index + 8 <= m_byte_buffer_len.value_or(0)) {
+    // Fast path: one unaligned big-endian load tops the bit buffer up to a whole number of bytes
+    uint64_t word = 0;
+    std::memcpy(&word, m_byte_data + m_byte_buffer_index, sizeof(word));
+    if constexpr (std::endian::native == std::endian::little) { word = std::byteswap(word); }
+
+    if (num_bytes == 8) {
+      m_bit_buffer = word;
+    } else {
+      m_bit_buffer = (m_bit_buffer << (num_bytes << 3U)) | (word >> (64U - (num_bytes << 3U)));
     }
-    m_bit_buffer_len += nidx << 3U;
-  } else if (m_bit_buffer_len <= 56) {
+    m_bit_buffer_len += num_bytes << 3U;
+    m_byte_buffer_index += num_bytes;
+  } else {
+    // Slow path near the end of the byte buffer, may trigger a refill from the underlying stream
     auto ttemp = read_underlying();
     if (ttemp == std::nullopt) { throw std::runtime_error("Reached EOF"); }
-    auto temp = ttemp.value();
-    m_bit_buffer = (m_bit_buffer << 8U) | temp;
+    m_bit_buffer = (m_bit_buffer << 8U) | ttemp.value();
     m_bit_buffer_len += 8;
   }
 
   assert(8 <= m_bit_buffer_len && m_bit_buffer_len <= 64);
-  m_byte_buffer_index += nidx;
 }
 
 std::optional<uint8_t> FlacLowLevelInput::read_byte()
@@ -168,7 +254,113 @@ std::optional<uint8_t> FlacLowLevelInput::read_byte()
 void FlacLowLevelInput::read_fully(std::vector<uint8_t> &bytes)
 {
   check_byte_aligned();
-  for (auto &byte : bytes) { byte = static_cast<uint8_t>(read_uint(8)); }
+  size_t done = 0;
+  for (; done < bytes.size() && m_bit_buffer_len > 0; ++done) { bytes[done] = static_cast<uint8_t>(read_uint(8)); }
+
+  // The rest is copied out of the window; the CRCs pick it up from there on the next update
+  while (done < bytes.size()) {
+    auto available = m_byte_buffer_len.value_or(0) - std::min(m_byte_buffer_index, m_byte_buffer_len.value_or(0));
+    auto copied = std::min(available, bytes.size() - done);
+    std::memcpy(bytes.data() + done, m_byte_data + m_byte_buffer_index, copied);
+    m_byte_buffer_index += copied;
+    done += copied;
+    if (done < bytes.size()) {
+      auto byte = read_underlying();
+      if (!byte.has_value()) { throw std::runtime_error("Reached EOF"); }
+      bytes[done++] = byte.value();
+    }
+  }
+}
+
+void FlacLowLevelInput::skip_bits(uint64_t num_of_bits)
+{
+  auto from_buffer = std::min<uint64_t>(num_of_bits, m_bit_buffer_len);
+  m_bit_buffer_len -= from_buffer;
+  num_of_bits -= from_buffer;
+
+  // Whole bytes are skipped inside the current window; the CRCs pick them up from the window on the next update
+  auto num_bytes = num_of_bits / 8;
+  while (num_bytes > 0) {
+    auto available = m_byte_buffer_len.value_or(0) - std::min(m_byte_buffer_index, m_byte_buffer_len.value_or(0));
+    auto skipped = std::min<uint64_t>(available, num_bytes);
+    m_byte_buffer_index += skipped;
+    num_bytes -= skipped;
+    if (num_bytes > 0) {
+      if (!read_underlying().has_value()) { throw std::runtime_error("Reached EOF"); }
+      --num_bytes;
+    }
+  }
+  read_uint(num_of_bits % 8);
+}
+
+void FlacLowLevelInput::skip_rice_codes(size_t param, size_t count)
+{
+  if (param > 31) {
+    const std::string msg{ "param= " + std::to_string(param) + ", is greater than 32" };
+    throw std::invalid_argument(msg);
+  }
+
+  // Same count-leading-zeros walk as read_rice_signed_ints_clz, minus the value reconstruction and the store
+  for (; count > 0; --count) {
+    if (m_bit_buffer_len <= 56 && m_byte_buffer_index + 8 <= m_byte_buffer_len.value_or(0)) { fill_bit_buffer(); }
+
+    const uint64_t window = m_bit_buffer_len == 0 ? 0 : m_bit_buffer << (64U - m_bit_buffer_len);
+    const auto quotient = static_cast<size_t>(std::countl_zero(window));
+    if (quotient + 1 + param <= m_bit_buffer_len) {
+      m_bit_buffer_len -= quotient + 1 + param;
+    } else {
+      read_rice_code(param);
+    }
+  }
+}
+
+bool FlacLowLevelInput::skip_to_sync_code()
+{
+  check_byte_aligned();
+  while (true) {
+    // Nothing is buffered, so the window can be searched for the first byte of the code directly
+    if (m_bit_buffer_len == 0 && m_byte_buffer_index < m_byte_buffer_len.value_or(0)) {
+      const auto *begin = m_byte_data + m_byte_buffer_index;
+      auto available = m_byte_buffer_len.value() - m_byte_buffer_index;
+      const auto *hit = static_cast<const uint8_t *>(std::memchr(begin, 0xFF, available));
+      m_byte_buffer_index += hit == nullptr ? available : static_cast<size_t>(hit - begin);
+    }
+
+    // The two candidate bytes are peeked in the bit buffer, where they are not consumed yet
+    while (m_bit_buffer_len < 16) {
+      // A refill would hash a peeked 0xFF at the end of the window and leave it outside the next one, so the window
+      // is restarted at that byte instead, with the CRCs up to date before it. A window holding only that byte ends
+      // the stream, where the byte is hashed either way.
+      const auto window_len = m_byte_buffer_len.value_or(0);
+      if (m_bit_buffer_len == 8 && (m_bit_buffer & 0xFFU) == 0xFF && m_byte_buffer_index >= window_len
+          && window_len > 1) {
+        update_crcs(1);
+        seek_to(get_position());
+        m_crc_start_index = 0;
+      }
+      auto byte = read_underlying();
+      if (!byte.has_value()) {
+        m_bit_buffer_len = 0;
+        return false;
+      }
+      m_bit_buffer = (m_bit_buffer << 8U) | byte.value();
+      m_bit_buffer_len += 8;
+    }
+
+    auto code = (m_bit_buffer >> (m_bit_buffer_len - 16)) & 0xFFFFU;
+    if ((code & 0xFFFEU) == 0xFFF8) { return true; }
+    m_bit_buffer_len -= 8;
+    if ((code & 0xFFU) != 0xFF) { m_bit_buffer_len -= 8; }
+  }
+}
+
+std::span<const uint8_t> FlacLowLevelInput::peek_window() const
+{
+  check_byte_aligned();
+  auto buffered = m_bit_buffer_len / 8U;
+  if (buffered > m_byte_buffer_index) { return {}; }
+  auto start = m_byte_buffer_index - buffered;
+  return { m_byte_data + start, m_byte_buffer_len.value_or(0) - start };// NOLINT
 }
 
 std::optional<uint8_t> FlacLowLevelInput::read_underlying()
@@ -177,26 +369,33 @@ std::optional<uint8_t> FlacLowLevelInput::read_underlying()
     if (!m_byte_buffer_len.has_value()) { return std::nullopt; }
     m_byte_buffer_start_pos += m_byte_buffer_len.value();
     update_crcs(0);
-    auto res = read_underlying(m_byte_buffer, 0, m_byte_buffer.size());
-    auto result = res.value_or(0);
-    m_byte_buffer_len = result;
-    m_crc_start_index = 0;
-    if (m_byte_buffer_len <= 0) { return std::nullopt; }
+    auto window = read_underlying_window();
+    m_byte_data = window.data();
+    m_byte_buffer_len = window.size();
     m_byte_buffer_index = 0;
+    m_crc_start_index = 0;
+    if (window.empty()) { return std::nullopt; }
   }
 
   assert(std::cmp_less(m_byte_buffer_index, m_byte_buffer_len.value_or(0)));
-  auto temp = m_byte_buffer.at(m_byte_buffer_index) & 0xFFU;
+  auto temp = m_byte_data[m_byte_buffer_index];
   m_byte_buffer_index++;
   return temp;
 }
 
+std::span<const uint8_t> FlacLowLevelInput::read_underlying_window()
+{
+  auto len = read_underlying(m_byte_buffer, 0, m_byte_buffer.size()).value_or(0);
+  return { m_byte_buffer.data(), len };
+}
+
 void FlacLowLevelInput::reset_crcs()
 {
   check_byte_aligned();
-  m_crc_start_index = (m_byte_buffer_index - m_bit_buffer_len) / 8U;
+  m_crc_start_index = m_byte_buffer_index - m_bit_buffer_len / 8U;
   m_crc8 = 0;
   m_crc16 = 0;
+  m_crc8_finished = false;
 }
 
 uint8_t FlacLowLevelInput::get_crc8()
@@ -204,6 +403,7 @@ uint8_t FlacLowLevelInput::get_crc8()
   check_byte_aligned();
   update_crcs(m_bit_buffer_len / 8);
   if ((m_crc8 >> 8U) != 0) { throw std::logic_error("Assertion error"); }
+  m_crc8_finished = true;
   return m_crc8;
 }
 
@@ -217,13 +417,12 @@ uint16_t FlacLowLevelInput::get_crc16()
 
 void FlacLowLevelInput::update_crcs(size_t unused_trailing_bytes)
 {
+  auto start = m_crc_start_index.value_or(0);
   auto end = m_byte_buffer_index - unused_trailing_bytes;
-  for (size_t i = m_crc_start_index.value_or(0); i < end; ++i) {
-    auto byte = m_byte_buffer.at(i) & 0xFFU;
-    m_crc8 = CRC8_TABLE.at(m_crc8 ^ byte) & 0xFFU;
-    m_crc16 = static_cast<uint16_t>(CRC16_TABLE.at((m_crc16 >> 8U) & byte) ^ ((m_crc16 & 0xFFU) << 8U));// NOLINT
-    assert((m_crc8 >> 8U) == 0);
-    assert((m_crc16 >> 16U) == 0);
+  if (end > start) {
+    const std::span<const uint8_t> bytes{ m_byte_data + start, end - start };
+    if (!m_crc8_finished) { m_crc8 = Crc::update_crc8(m_crc8, bytes); }
+    m_crc16 = Crc::update_crc16(m_crc16, bytes);
   }
   m_crc_start_index = end;
 }
@@ -231,53 +430,15 @@ void FlacLowLevelInput::update_crcs(size_t unused_trailing_bytes)
 void FlacLowLevelInput::close()
 {
   m_byte_buffer.clear();
+  m_byte_data = m_byte_buffer.data();
   m_byte_buffer_len = std::nullopt;
   m_byte_buffer_index = 0;
   m_bit_buffer = 0;
   m_bit_buffer_len = 0;
   m_crc8 = 0;
   m_crc16 = 0;
+  m_crc8_finished = false;
   m_crc_start_index = 0;
 }
 
-void FlacLowLevelInput::initialize_tables()
-{
-  RICE_DECODING_CONSUMED_TABLES.assign(31, std::vector<uint8_t>(1U << RICE_DECODING_TABLE_BITS, 0));
-
-  RICE_DECODING_VALUE_TABLES.assign(31, std::vector<uint32_t>(1U << RICE_DECODING_TABLE_BITS, 0));
-
-  for (size_t param = 0; param < RICE_DECODING_CONSUMED_TABLES.size(); ++param) {
-    auto consumed = RICE_DECODING_CONSUMED_TABLES.at(param);
-    auto values = RICE_DECODING_VALUE_TABLES.at(param);
-
-    for (size_t i = 0;; ++i) {
-      auto num_bits = (i >> param) + 1 + param;
-      if (num_bits > RICE_DECODING_TABLE_BITS) { break; }
-      auto bits = ((1U << param) | (i & ((1U << param) - 1U)));
-      auto shift = RICE_DECODING_TABLE_BITS - num_bits;
-      for (size_t j = 0; j < (1U << shift); j++) {
-        consumed.at((bits << shift) | j) = static_cast<uint8_t>(num_bits);
-        values.at((bits << shift) | j) = static_cast<uint32_t>((i >> 1U) ^ -(i & 1U));
-      }
-    }
-    if (consumed.at(0) != 0) { throw std::logic_error("Assertion error"); }
-  }
-}
-
-void FlacLowLevelInput::initialize_crcs()
-{
-  CRC8_TABLE.assign(256, 0);
-  CRC16_TABLE.assign(256, 0);
-
-  for (size_t i = 0; i < CRC8_TABLE.size(); ++i) {
-    auto temp8 = i;
-    auto temp16 = i << 8U;
-    for (size_t j = 0; j < 8U; ++j) {
-      temp8 = (temp8 << 1U) ^ ((temp8 >> 7U) * 0x107U);
-      temp16 = (temp16 << 1U) ^ ((temp16 >> 15U) * 0x18005U);
-    }
-    CRC8_TABLE.at(i) = static_cast<uint8_t>(temp8);
-    CRC16_TABLE.at(i) = static_cast<uint16_t>(temp16);
-  }
-}
 }// namespace flac
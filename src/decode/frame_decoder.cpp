@@ -1,53 +1,134 @@
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <flac_codec/common/frame_info.h>
+#include <flac_codec/decode/byte_flac_input.h>
+#include <flac_codec/decode/channel_kernels.h>
 #include <flac_codec/decode/data_format_exception.h>
 #include <flac_codec/decode/flac_low_level_input.h>
 #include <flac_codec/decode/frame_decoder.h>
-#include <memory>
+#include <flac_codec/decode/lpc_kernels.h>
+#include <flac_codec/decode/mmap_flac_input.h>
+#include <flac_codec/decode/pcm_kernels.h>
+#include <flac_codec/decode/read_ahead_file_flac_input.h>
+#include <flac_codec/decode/sample_buffer.h>
+#include <flac_codec/decode/seekable_file_flac_input.h>
+#include <flac_codec/decode/sync_kernels.h>
 #include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 namespace flac {
 
-FrameDecoder::FrameDecoder(std::unique_ptr<IFlacLowLevelInput> &input, uint32_t expect_depth)
-  : m_input(std::move(input)), m_expected_bit_depth(expect_depth), m_temp0(65536), m_temp1(65536),
+namespace {
+
+  // Branch-free reduction the compiler can vectorize, used instead of a compare-and-throw per sample
+  template<typename Sample> std::pair<Sample, Sample> get_min_max(const Sample *data, size_t len)
+  {
+    Sample min = 0;
+    Sample max = 0;
+    for (size_t i = 0; i < len; ++i) {
+      min = std::min(min, data[i]);
+      max = std::max(max, data[i]);
+    }
+    return { min, max };
+  }
+
+  template<typename Out> size_t get_frame_capacity(const std::vector<std::vector<Out>> &out)
+  {
+    return out.empty() ? 0 : out[0].size();
+  }
+
+  size_t get_frame_capacity(const PcmBuffer &out) { return out.get_frame_capacity(); }
+
+  size_t get_frame_capacity(const SampleBuffer &out) { return out.frame_capacity; }
+
+  template<typename Out> size_t get_num_channels(const std::vector<std::vector<Out>> &out) { return out.size(); }
+
+  size_t get_num_channels(const PcmBuffer &out) { return out.num_channels; }
+
+  size_t get_num_channels(const SampleBuffer &out) { return out.num_channels; }
+
+  // Copies a block between sample types; narrowing is only ever done for values that fit
+  template<typename From, typename To> void convert_block(const From *src, To *dst, size_t len)
+  {
+    for (size_t i = 0; i < len; ++i) { dst[i] = static_cast<To>(src[i]); }
+  }
+
+  template<typename From> void convert_block(const From *src, int32_t *dst, size_t stride, size_t len)
+  {
+    for (size_t i = 0; i < len; ++i) { dst[i * stride] = static_cast<int32_t>(src[i]); }
+  }
+
+}// namespace
+
+template<typename Input, ValidationLevel Level, typename Sample>
+FrameDecoder<Input, Level, Sample>::FrameDecoder(Input &input, uint32_t expect_depth)
+  : m_input(input), m_expected_bit_depth(expect_depth), m_temp0(65536), m_temp1(65536),
     m_current_block_size(std::nullopt)
 {}
 
-std::optional<FrameInfo> FrameDecoder::read_frame(std::vector<std::vector<int64_t>> &out_samples, size_t out_offset)
+template<typename Input, ValidationLevel Level, typename Sample>
+std::optional<FrameInfo> FrameDecoder<Input, Level, Sample>::read_frame(std::vector<std::vector<int64_t>> &out_samples,
+  size_t out_offset)
+{
+  return read_frame_into(out_samples, out_offset);
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+std::optional<FrameInfo> FrameDecoder<Input, Level, Sample>::read_frame(std::vector<std::vector<int32_t>> &out_samples,
+  size_t out_offset)
 {
-  if (!m_current_block_size.has_value()) { throw std::runtime_error("Concurrent call"); }
+  return read_frame_into(out_samples, out_offset);
+}
 
-  auto start_byte = m_input->get_position();
-  auto tmeta = FrameInfo::read_frame(*m_input);
+template<typename Input, ValidationLevel Level, typename Sample>
+std::optional<FrameInfo> FrameDecoder<Input, Level, Sample>::read_frame(const PcmBuffer &out, size_t out_offset)
+{
+  return read_frame_into(out, out_offset);
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+std::optional<FrameInfo> FrameDecoder<Input, Level, Sample>::read_frame(const SampleBuffer &out, size_t out_offset)
+{
+  return read_frame_into(out, out_offset);
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+template<typename Output>
+std::optional<FrameInfo> FrameDecoder<Input, Level, Sample>::read_frame_into(Output &out, size_t out_offset)
+{
+  if (m_current_block_size.has_value()) { throw std::runtime_error("Concurrent call"); }
+
+  auto start_byte = m_input.get_position();
+  auto tmeta = FrameInfo::read_frame(m_input);
   if (!tmeta.has_value()) { return std::nullopt; }
   auto meta = tmeta.value();
-  if (!meta.m_bit_depth.has_value() && meta.m_bit_depth.value_or(0) != m_expected_bit_depth) {
+  if (meta.m_bit_depth.has_value() && meta.m_bit_depth.value() != m_expected_bit_depth) {
     throw DataFormatException("Bit depth mismatch");
   }
 
   m_current_block_size = meta.m_block_size;
-  if (out_offset > out_samples[0].size()) { throw std::runtime_error("Index is out of bounds"); }
-  if (out_samples.size() < meta.m_num_channels.value_or(0)) {
+  auto capacity = get_frame_capacity(out);
+  if (out_offset > capacity) { throw std::runtime_error("Index is out of bounds"); }
+  if (get_num_channels(out) < meta.m_num_channels.value_or(0)) {
     throw std::invalid_argument("Output array too small for number of channels");
   }
-  if (out_offset > out_samples[0].size() - m_current_block_size.value_or(0)) {
-    throw std::runtime_error("Index is out of bounds");
-  }
+  if (m_current_block_size.value_or(0) > capacity - out_offset) { throw std::runtime_error("Index is out of bounds"); }
 
-  decode_subframes(m_expected_bit_depth, meta.m_channel_assignment.value_or(0), out_samples, out_offset);
+  decode_subframes(m_expected_bit_depth, meta.m_channel_assignment.value_or(0), out, out_offset);
 
-  if (m_input->read_uint((8 - m_input->get_position()) % 8) != 0) { throw DataFormatException("Invalid padding bits"); }
-  auto computed_crc16 = m_input->get_crc16();
-  if (m_input->read_uint(16) != computed_crc16) { throw DataFormatException("CRC-16 mismatch"); }
+  if (m_input.read_uint((8 - m_input.get_bit_position()) % 8) != 0) { throw DataFormatException("Invalid padding bits"); }
+  auto computed_crc16 = m_input.get_crc16();
+  if (m_input.read_uint(16) != computed_crc16) { throw DataFormatException("CRC-16 mismatch"); }
 
-  auto frame_size = m_input->get_position() - start_byte;
+  auto frame_size = m_input.get_position() - start_byte;
   if (frame_size < 10) { throw std::runtime_error("Assertion error"); }
   if (static_cast<uint32_t>(frame_size) != frame_size) { throw DataFormatException("Frame size too large"); }
 
@@ -57,9 +138,179 @@ std::optional<FrameInfo> FrameDecoder::read_frame(std::vector<std::vector<int64_
   return meta;
 }
 
-void FrameDecoder::decode_subframes(uint32_t bit_depth,
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::set_channel_mask(uint8_t mask)
+{
+  m_channel_mask = mask;
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+std::optional<FrameInfo> FrameDecoder<Input, Level, Sample>::skim_frame(uint32_t max_frame_size)
+{
+  if (m_current_block_size.has_value()) { throw std::runtime_error("Concurrent call"); }
+
+  auto start_byte = m_input.get_position();
+  auto tmeta = FrameInfo::read_frame(m_input);
+  if (!tmeta.has_value()) { return std::nullopt; }
+  auto meta = tmeta.value();
+  if (meta.m_bit_depth.has_value() && meta.m_bit_depth.value() != m_expected_bit_depth) {
+    throw DataFormatException("Bit depth mismatch");
+  }
+
+  auto end_byte = max_frame_size != 0 ? find_frame_end(start_byte, max_frame_size, meta) : std::nullopt;
+  if (!end_byte.has_value()) {
+    m_current_block_size = meta.m_block_size;
+    skim_subframes(m_expected_bit_depth, meta.m_channel_assignment.value_or(0));
+    m_current_block_size = std::nullopt;
+
+    if (m_input.read_uint((8 - m_input.get_bit_position()) % 8) != 0) {
+      throw DataFormatException("Invalid padding bits");
+    }
+    auto computed_crc16 = m_input.get_crc16();
+    if (m_input.read_uint(16) != computed_crc16) { throw DataFormatException("CRC-16 mismatch"); }
+    end_byte = m_input.get_position();
+  }
+
+  auto frame_size = end_byte.value() - start_byte;
+  if (frame_size < 10) { throw std::runtime_error("Assertion error"); }
+  if (static_cast<uint32_t>(frame_size) != frame_size) { throw DataFormatException("Frame size too large"); }
+  meta.m_frame_size = static_cast<uint32_t>(frame_size);
+  return meta;
+}
+
+// The CRC-16 over a whole frame, footer included, is zero, so the frame ends at a sync code, or the end of the stream,
+// where the running CRC is zero. A sync pattern inside the frame passes that by chance once in 65536, so the header
+// there must also pass its CRC-8 and carry the next frame or sample number with the same blocking strategy. Leaves the
+// input at the end of the frame, or just after the header it started from when there is none within max_frame_size
+// bytes.
+template<typename Input, ValidationLevel Level, typename Sample>
+std::optional<size_t>
+  FrameDecoder<Input, Level, Sample>::find_frame_end(size_t start_byte, uint32_t max_frame_size, const FrameInfo &meta)
+{
+  const bool variable = meta.m_sample_offset.has_value();
+  const uint64_t next = variable ? meta.m_sample_offset.value() + meta.m_block_size.value_or(0)
+                                 : uint64_t{ meta.m_frame_index.value_or(0) } + 1;
+
+  while (true) {
+    const bool found = m_input.skip_to_sync_code();
+    auto pos = m_input.get_position();
+    if (pos - start_byte > max_frame_size) { break; }
+    if (m_input.get_crc16() == 0) {
+      if (!found) { return pos; }
+
+      // The header is checked in place while it is in the window, otherwise it is read out and the input put back
+      auto header = m_input.peek_window();
+      const bool in_window =
+        header.size() >= SyncKernels::MAX_HEADER_SIZE || pos + header.size() >= m_input.get_length();
+      std::array<uint8_t, SyncKernels::MAX_HEADER_SIZE> copy{};
+      size_t copied = 0;
+      if (!in_window) {
+        for (; copied < copy.size(); ++copied) {
+          auto byte = m_input.read_byte();
+          if (!byte.has_value()) { break; }
+          copy.at(copied) = byte.value();
+        }
+        header = std::span<const uint8_t>(copy).first(copied);
+      }
+
+      auto position = SyncKernels::get_header_position(header);
+      const bool matches = position == next && ((header[1] & 1U) != 0) == variable;
+      if (!in_window) {
+        // Back to the candidate with the CRC-16 running from the start of the frame again
+        m_input.seek_to(start_byte);
+        m_input.reset_crcs();
+        m_input.skip_bits(uint64_t{ pos - start_byte } * 8);
+        if (!matches) { m_input.skip_to_sync_code(); }
+      }
+      if (matches) { return pos; }
+    }
+    if (!found) { break; }
+    m_input.read_uint(8);
+  }
+
+  m_input.seek_to(start_byte);
+  FrameInfo::read_frame(m_input);
+  return std::nullopt;
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::skim_subframes(uint32_t bit_depth, int chan_asgn)
+{
+  if (0 <= chan_asgn && chan_asgn <= 7) {
+    for (int ch = 0; ch <= chan_asgn; ++ch) { skim_subframe(bit_depth); }
+  } else if (8 <= chan_asgn && chan_asgn <= 10) {
+    skim_subframe(bit_depth + (chan_asgn == 9 ? 1 : 0));
+    skim_subframe(bit_depth + (chan_asgn == 9 ? 0 : 1));
+  } else {
+    throw DataFormatException("Reserved channel assignment");
+  }
+}
+
+// Same bit layout as decode_subframe, with every value that is not needed to find the next field skipped
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::skim_subframe(uint32_t bit_depth)
+{
+  auto block_size = m_current_block_size.value_or(0);
+  auto [type, shift] = read_subframe_header(bit_depth);
+  bit_depth -= shift;
+
+  if (type == 0) {
+    m_input.skip_bits(bit_depth);
+  } else if (type == 1) {
+    m_input.skip_bits(uint64_t{ block_size } * bit_depth);
+  } else if (8 <= type && type <= 12) {
+    auto order = type - 8;
+    if (order > block_size) { throw DataFormatException("Fixed prediction order exceeds block size "); }
+    m_input.skip_bits(uint64_t{ order } * bit_depth);
+    skim_residuals(order);
+  } else if (32 <= type && type <= 63) {
+    auto order = type - 31;
+    if (order > block_size) { throw DataFormatException("LPC order exceeds block size"); }
+    m_input.skip_bits(uint64_t{ order } * bit_depth);
+    auto precision = m_input.read_uint(4) + 1;
+    if (precision == 16) { throw DataFormatException("Invalid LPC precision"); }
+    if (m_input.read_signed_int(5) < 0) { throw DataFormatException("Invalid LPC shift"); }
+    m_input.skip_bits(uint64_t{ order } * uint64_t(precision));
+    skim_residuals(order);
+  } else {
+    throw DataFormatException("Reserved subframe type");
+  }
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::skim_residuals(uint32_t warmup)
+{
+  auto method = m_input.read_uint(2);
+  if (method >= 2) { throw DataFormatException("Reserved residual coding method"); }
+
+  const int param_bits = method == 0 ? 4 : 5;
+  const int escape_param = method == 0 ? 0xF : 0x1F;
+
+  auto partition_order = m_input.read_uint(4);
+  const uint64_t num_partitions = 1U << static_cast<uint8_t>(partition_order);
+  auto block_size = m_current_block_size.value_or(0);
+  if (block_size % num_partitions != 0) {
+    throw DataFormatException("Block size not divisible by number of Rice partitions");
+  }
+  auto partition_size = block_size / num_partitions;
+  if (warmup > partition_size) { throw DataFormatException("Prediction order exceeds first Rice partition"); }
+
+  for (uint64_t part = 0; part < num_partitions; ++part) {
+    auto count = partition_size - (part == 0 ? warmup : 0);
+    auto param = m_input.read_uint(size_t(param_bits));
+    if (param == escape_param) {
+      m_input.skip_bits(count * uint64_t(m_input.read_uint(5)));
+    } else {
+      m_input.skip_rice_codes(size_t(param), size_t(count));
+    }
+  }
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+template<typename Output>
+void FrameDecoder<Input, Level, Sample>::decode_subframes(uint32_t bit_depth,
   int chan_asgn,
-  std::vector<std::vector<int64_t>> &out_samples,
+  Output &out,
   size_t out_offset)
 {
   if (bit_depth < 1 || bit_depth > 32) { throw std::invalid_argument("Bit depth is invalid"); }
@@ -68,68 +319,276 @@ void FrameDecoder::decode_subframes(uint32_t bit_depth,
   if (0 <= chan_asgn && chan_asgn <= 7) {
     const int num_channels = chan_asgn + 1;
     for (size_t ch = 0; std::cmp_less(ch, num_channels); ++ch) {
-      decode_subframe(bit_depth, m_temp0);
-      auto out_chan = out_samples[ch];
-      for (size_t i = 0; i < m_current_block_size.value_or(0); ++i) {
-        out_chan[out_offset + i] = check_bit_depth(m_temp0[i], bit_depth);
+      if (!is_requested(ch)) {
+        skim_subframe(bit_depth);
+        continue;
       }
+      decode_subframe(bit_depth, m_temp0);
+      store_block(m_temp0, out, ch, out_offset, bit_depth);
     }
   } else if (8 <= chan_asgn && chan_asgn <= 10) {
-    decode_subframe(bit_depth + (chan_asgn == 9 ? 1 : 0), m_temp0);
-    decode_subframe(bit_depth + (chan_asgn == 9 ? 0 : 1), m_temp1);
-
-    if (chan_asgn == 8) {
-      for (size_t i = 0; i < m_current_block_size.value_or(0); ++i) { m_temp1[i] = m_temp0[i] - m_temp1[i]; }
-    } else if (chan_asgn == 9) {
-      for (size_t i = 0; i < m_current_block_size.value_or(0); ++i) { m_temp0[i] += m_temp1[i]; }
-    } else if (chan_asgn == 10) {
-      for (size_t i = 0; i < m_current_block_size.value_or(0); ++i) {
-        auto side = static_cast<uint64_t>(m_temp1[i]);
-        auto right = static_cast<uint64_t>(m_temp0[i]) - (side >> 1U);
-        m_temp1[i] = static_cast<long>(right);
-        m_temp0[i] = static_cast<long>(right + side);
+    decode_stereo_subframes(bit_depth, chan_asgn, out, out_offset);
+  } else {
+    throw DataFormatException("Reserved channel assignment");
+  }
+}
+
+// The first subframe holds left, side or mid and the second side or right. A subframe that is the requested channel
+// itself is stored as decoded; otherwise the pair is restored, which needs both.
+template<typename Input, ValidationLevel Level, typename Sample>
+template<typename Output>
+void FrameDecoder<Input, Level, Sample>::decode_stereo_subframes(uint32_t bit_depth,
+  int chan_asgn,
+  Output &out,
+  size_t out_offset)
+{
+  auto mode = ChannelKernels::StereoMode::MidSide;
+  if (chan_asgn == 8) {
+    mode = ChannelKernels::StereoMode::LeftSide;
+  } else if (chan_asgn == 9) {
+    mode = ChannelKernels::StereoMode::SideRight;
+  }
+
+  const bool left = is_requested(0);
+  const bool right = is_requested(1);
+  const bool needs_first = mode == ChannelKernels::StereoMode::SideRight ? left : left || right;
+  const bool needs_second = mode == ChannelKernels::StereoMode::LeftSide ? right : left || right;
+
+  auto first_depth = bit_depth + (chan_asgn == 9 ? 1 : 0);
+  auto second_depth = bit_depth + (chan_asgn == 9 ? 0 : 1);
+  if (needs_first) {
+    decode_subframe(first_depth, m_temp0);
+  } else {
+    skim_subframe(first_depth);
+  }
+  if (needs_second) {
+    decode_subframe(second_depth, m_temp1);
+  } else {
+    skim_subframe(second_depth);
+  }
+
+  if (left && right) {
+    store_stereo_block(mode, out, out_offset, bit_depth);
+  } else if (left) {
+    if (mode != ChannelKernels::StereoMode::LeftSide) { restore_stereo(mode, bit_depth); }
+    store_block(m_temp0, out, 0, out_offset, bit_depth);
+  } else if (right) {
+    if (mode != ChannelKernels::StereoMode::SideRight) { restore_stereo(mode, bit_depth); }
+    store_block(m_temp1, out, 1, out_offset, bit_depth);
+  }
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+bool FrameDecoder<Input, Level, Sample>::is_requested(size_t channel) const
+{
+  return ((m_channel_mask >> channel) & 1U) != 0;
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+int32_t FrameDecoder<Input, Level, Sample>::check_bit_depth(int64_t val, uint32_t depth)
+{
+  assert(1 <= depth && depth <= 32);
+
+  if (val >> (depth - 1U) == val >> depth) {// NOLINT
+    return static_cast<int32_t>(val);
+  } else {
+    const std::string msg(std::to_string(val) + " is not a signed " + std::to_string(depth) + "-bit value");
+    throw std::invalid_argument(msg);
+  }
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+template<typename Out>
+void FrameDecoder<Input, Level, Sample>::store_block(const std::vector<Sample> &block,
+  std::vector<std::vector<Out>> &out_samples,
+  size_t channel,
+  size_t out_offset,
+  uint32_t bit_depth)
+{
+  auto block_size = size_t(m_current_block_size.value_or(0));
+  const std::span<const Sample> src{ block.data(), block_size };
+  if constexpr (std::is_same_v<Out, Sample>) {
+    const std::span<Sample> dst{ out_samples[channel].data() + out_offset, block_size };
+    if (!ChannelKernels::store_channel(src, dst, bit_depth, Level != ValidationLevel::Trusted)) {
+      report_out_of_range<Sample>(dst, {}, bit_depth);
+    }
+  } else {
+    check_block(src, bit_depth);
+    convert_block(src.data(), out_samples[channel].data() + out_offset, block_size);
+  }
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::store_block(const std::vector<Sample> &block,
+  const PcmBuffer &out,
+  size_t channel,
+  size_t out_offset,
+  uint32_t bit_depth)
+{
+  const std::span<const Sample> src{ block.data(), size_t(m_current_block_size.value_or(0)) };
+  check_block(src, bit_depth);
+  store_pcm(src, out, channel, out_offset, bit_depth);
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::store_block(const std::vector<Sample> &block,
+  const SampleBuffer &out,
+  size_t channel,
+  size_t out_offset,
+  uint32_t bit_depth)
+{
+  auto block_size = size_t(m_current_block_size.value_or(0));
+  const std::span<const Sample> src{ block.data(), block_size };
+  int32_t *dst = out.channels[channel] + out_offset * out.stride;
+  if constexpr (std::is_same_v<Sample, int32_t>) {
+    if (out.stride == 1) {
+      if (!ChannelKernels::store_channel(src, { dst, block_size }, bit_depth, Level != ValidationLevel::Trusted)) {
+        report_out_of_range<Sample>(src, {}, bit_depth);
       }
-    } else {
-      throw std::runtime_error("Assertion error");
+      return;
     }
+  }
+  check_block(src, bit_depth);
+  convert_block(src.data(), dst, out.stride, block_size);
+}
 
-    auto out_left = out_samples[0];
-    auto out_right = out_samples[1];
-    for (size_t i = 0; i < m_current_block_size.value_or(0); ++i) {
-      out_left[out_offset + i] = check_bit_depth(m_temp0[i], bit_depth);
-      out_right[out_offset + i] = check_bit_depth(m_temp1[i], bit_depth);
+template<typename Input, ValidationLevel Level, typename Sample>
+template<typename Out>
+void FrameDecoder<Input, Level, Sample>::store_stereo_block(ChannelKernels::StereoMode mode,
+  std::vector<std::vector<Out>> &out_samples,
+  size_t out_offset,
+  uint32_t bit_depth)
+{
+  auto block_size = size_t(m_current_block_size.value_or(0));
+  if constexpr (std::is_same_v<Out, Sample>) {
+    const std::span<Sample> left{ out_samples[0].data() + out_offset, block_size };
+    const std::span<Sample> right{ out_samples[1].data() + out_offset, block_size };
+    if (!ChannelKernels::store_stereo(mode,
+          { m_temp0.data(), block_size },
+          { m_temp1.data(), block_size },
+          left,
+          right,
+          bit_depth,
+          Level != ValidationLevel::Trusted)) {
+      report_out_of_range<Sample>(left, right, bit_depth);
     }
   } else {
-    throw DataFormatException("Reserved channel assignment");
+    restore_stereo(mode, bit_depth);
+    convert_block(m_temp0.data(), out_samples[0].data() + out_offset, block_size);
+    convert_block(m_temp1.data(), out_samples[1].data() + out_offset, block_size);
   }
 }
 
-int32_t FrameDecoder::check_bit_depth(int64_t val, uint32_t depth)
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::store_stereo_block(ChannelKernels::StereoMode mode,
+  const PcmBuffer &out,
+  size_t out_offset,
+  uint32_t bit_depth)
 {
-  assert(1 <= depth && depth <= 32);
+  restore_stereo(mode, bit_depth);
+  const std::span<const Sample> left{ m_temp0.data(), size_t(m_current_block_size.value_or(0)) };
+  const std::span<const Sample> right{ m_temp1.data(), left.size() };
+  if (out.interleaved && out.num_channels == 2) {
+    auto size = PcmKernels::get_sample_size(out.encoding);
+    PcmKernels::store_stereo(left, right, out.data.subspan(out_offset * 2 * size), out.encoding, bit_depth);
+  } else {
+    store_pcm(left, out, 0, out_offset, bit_depth);
+    store_pcm(right, out, 1, out_offset, bit_depth);
+  }
+}
 
-  auto value = static_cast<uint64_t>(val);
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::store_stereo_block(ChannelKernels::StereoMode mode,
+  const SampleBuffer &out,
+  size_t out_offset,
+  uint32_t bit_depth)
+{
+  auto block_size = size_t(m_current_block_size.value_or(0));
+  int32_t *left = out.channels[0] + out_offset * out.stride;
+  int32_t *right = out.channels[1] + out_offset * out.stride;
+  if constexpr (std::is_same_v<Sample, int32_t>) {
+    if (out.stride == 1) {
+      if (!ChannelKernels::store_stereo(mode,
+            { m_temp0.data(), block_size },
+            { m_temp1.data(), block_size },
+            { left, block_size },
+            { right, block_size },
+            bit_depth,
+            Level != ValidationLevel::Trusted)) {
+        report_out_of_range<Sample>({ left, block_size }, { right, block_size }, bit_depth);
+      }
+      return;
+    }
+  }
+  restore_stereo(mode, bit_depth);
+  convert_block(m_temp0.data(), left, out.stride, block_size);
+  convert_block(m_temp1.data(), right, out.stride, block_size);
+}
+
+// The kernels read each pair before writing it, so the channels can be restored in place when the output needs
+// another pass anyway
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::restore_stereo(ChannelKernels::StereoMode mode, uint32_t bit_depth)
+{
+  const std::span<Sample> left{ m_temp0.data(), size_t(m_current_block_size.value_or(0)) };
+  const std::span<Sample> right{ m_temp1.data(), left.size() };
+  if (!ChannelKernels::store_stereo(mode, left, right, left, right, bit_depth, Level != ValidationLevel::Trusted)) {
+    report_out_of_range<Sample>(left, right, bit_depth);
+  }
+}
 
-  if (value >> (depth - 1U) == value >> depth) {
-    return static_cast<int32_t>(value);
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::check_block(std::span<const Sample> block, uint32_t bit_depth)
+{
+  if constexpr (Level != ValidationLevel::Trusted) {
+    const int64_t lower_bound = -(int64_t{ 1 } << (bit_depth - 1U));// NOLINT
+    auto [min, max] = get_min_max(block.data(), block.size());
+    if (min < lower_bound || max > -(lower_bound + 1)) { report_out_of_range<Sample>(block, {}, bit_depth); }
+  }
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::store_pcm(std::span<const Sample> src,
+  const PcmBuffer &out,
+  size_t channel,
+  size_t out_offset,
+  uint32_t bit_depth)
+{
+  auto size = PcmKernels::get_sample_size(out.encoding);
+  if (out.interleaved) {
+    auto stride = size_t(out.num_channels) * size;
+    auto start = out_offset * stride + channel * size;
+    PcmKernels::store_channel(src, out.data.subspan(start), stride, out.encoding, bit_depth);
   } else {
-    const std::string msg(std::to_string(value) + " is not a signed " + std::to_string(depth) + "-bit value");
-    throw std::invalid_argument(msg);
+    auto start = (channel * out.get_frame_capacity() + out_offset) * size;
+    PcmKernels::store_channel(src, out.data.subspan(start), size, out.encoding, bit_depth);
   }
 }
 
-void FrameDecoder::decode_subframe(uint32_t bit_depth, std::vector<int64_t> &result)
+// The output kernels only flag a block, this finds the first offending sample so the error matches a per-sample check
+template<typename Input, ValidationLevel Level, typename Sample>
+template<typename Out>
+void FrameDecoder<Input, Level, Sample>::report_out_of_range(std::span<const Out> left,
+  std::span<const Out> right,
+  uint32_t bit_depth)
 {
-  if (bit_depth < 1 || bit_depth > 33) { throw std::invalid_argument("bit_depth is invalid"); }
-  if (result.size() < m_current_block_size.value_or(0)) { throw std::invalid_argument("result is invalid"); }
+  for (size_t i = 0; i < left.size(); ++i) {
+    check_bit_depth(left[i], bit_depth);
+    if (i < right.size()) { check_bit_depth(right[i], bit_depth); }
+  }
+  throw std::runtime_error("Assertion error");
+}
 
-  if (m_input->read_uint(1) != 0) { throw DataFormatException("Invalid padding bit"); }
+template<typename Input, ValidationLevel Level, typename Sample>
+std::pair<uint32_t, uint32_t> FrameDecoder<Input, Level, Sample>::read_subframe_header(uint32_t bit_depth)
+{
+  if (m_input.read_uint(1) != 0) { throw DataFormatException("Invalid padding bit"); }
 
-  auto type = m_input->read_uint(6);
-  auto shift = m_input->read_uint(1);
+  auto type = m_input.read_uint(6);
+  auto shift = m_input.read_uint(1);
 
   if (shift == 1) {
-    while (m_input->read_uint(1) == 0) {
+    while (m_input.read_uint(1) == 0) {
       if (std::cmp_greater_equal(shift, bit_depth)) {
         throw DataFormatException("Waste-bits-per-samples exceeds bit depth");
       }
@@ -138,12 +597,32 @@ void FrameDecoder::decode_subframe(uint32_t bit_depth, std::vector<int64_t> &res
   }
 
   if (!(0 <= shift && shift <= int(bit_depth))) { throw std::runtime_error("Assertion error"); }// NOLINT
-  bit_depth -= uint32_t(shift);
+  return { uint32_t(type), uint32_t(shift) };
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+Sample FrameDecoder<Input, Level, Sample>::read_sample(uint32_t bit_depth)
+{
+  if constexpr (std::is_same_v<Sample, int64_t>) {
+    return m_input.read_signed_long(bit_depth);
+  } else {
+    return m_input.read_signed_int(bit_depth);
+  }
+}
+
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::decode_subframe(uint32_t bit_depth, std::vector<Sample> &result)
+{
+  if (bit_depth < 1 || bit_depth > 33) { throw std::invalid_argument("bit_depth is invalid"); }
+  if (result.size() < m_current_block_size.value_or(0)) { throw std::invalid_argument("result is invalid"); }
+
+  auto [type, shift] = read_subframe_header(bit_depth);
+  bit_depth -= shift;
 
   if (type == 0) {
-    std::fill(result.begin(), result.begin() + m_current_block_size.value_or(0), m_input->read_signed_int(bit_depth));
+    std::fill(result.begin(), result.begin() + m_current_block_size.value_or(0), read_sample(bit_depth));
   } else if (type == 1) {
-    for (size_t i = 0; i < m_current_block_size.value_or(0); ++i) { result[i] = m_input->read_signed_int(bit_depth); }
+    for (size_t i = 0; i < m_current_block_size.value_or(0); ++i) { result[i] = read_sample(bit_depth); }
   } else if (8 <= type && type <= 12) {
     decode_fixed_prediction_subframe(type - 8, bit_depth, result);
   } else if (32 <= type && type <= 63) {
@@ -157,12 +636,13 @@ void FrameDecoder::decode_subframe(uint32_t bit_depth, std::vector<int64_t> &res
   }
 }
 
-void FrameDecoder::decode_fixed_prediction_subframe(int64_t pred_order,
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::decode_fixed_prediction_subframe(int64_t pred_order,
   uint32_t bit_depth,
-  std::vector<int64_t> &result)
+  std::vector<Sample> &result)
 {
   if (bit_depth < 1 || bit_depth > 33) { throw std::invalid_argument("bit_depth is invalid"); }
-  if (pred_order < 0 || size_t(pred_order) >= FIXED_PREDICTION_COEFFICIENTS.size()) {
+  if (pred_order < 0 || size_t(pred_order) > LpcKernels::MAX_FIXED_ORDER) {
     throw std::invalid_argument("pred_order id invalid");
   }
   if (std::cmp_greater(pred_order, m_current_block_size.value_or(0))) {
@@ -170,14 +650,16 @@ void FrameDecoder::decode_fixed_prediction_subframe(int64_t pred_order,
   }
   if (result.size() < m_current_block_size.value_or(0)) { throw std::invalid_argument("result size is invalid"); }
 
-  for (size_t i = 0; std::cmp_less(i, pred_order); ++i) { result[i] = m_input->read_signed_int(bit_depth); }
+  for (size_t i = 0; std::cmp_less(i, pred_order); ++i) { result[i] = read_sample(bit_depth); }
   read_residuals(pred_order, result);
-  restore_lpc(result, FIXED_PREDICTION_COEFFICIENTS.at(size_t(pred_order)), bit_depth, 0);
+  LpcKernels::restore_fixed({ result.data(), size_t(m_current_block_size.value_or(0)) }, size_t(pred_order));
+  check_restored(result, size_t(pred_order), bit_depth);
 }
 
-void FrameDecoder::decode_linear_predictive_coding_subframe(int64_t lpc_order,
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::decode_linear_predictive_coding_subframe(int64_t lpc_order,
   uint32_t bit_depth,
-  std::vector<int64_t> &result)
+  std::vector<Sample> &result)
 {
   if (bit_depth < 1 || bit_depth > 33) { throw std::invalid_argument("bit_depth is invalid"); }
   if (lpc_order < 1 || lpc_order > 32) { throw std::invalid_argument("lpc_order is invalid"); }
@@ -186,23 +668,24 @@ void FrameDecoder::decode_linear_predictive_coding_subframe(int64_t lpc_order,
     throw std::invalid_argument("result size is invalid");
   }
 
-  for (size_t i = 0; std::cmp_less(i, lpc_order); ++i) { result.at(i) = m_input->read_signed_int(bit_depth); }
+  for (size_t i = 0; std::cmp_less(i, lpc_order); ++i) { result.at(i) = read_sample(bit_depth); }
 
-  auto precision = m_input->read_uint(4) + 1;
+  auto precision = m_input.read_uint(4) + 1;
   if (precision == 16) { throw DataFormatException("Invalid LPC precision"); }
 
-  auto shift = m_input->read_signed_int(5);
+  auto shift = m_input.read_signed_int(5);
   if (shift < 0) { throw DataFormatException("Invalid LPC shift"); }
 
-  std::vector<int64_t> coefs(static_cast<size_t>(lpc_order));
-  for (auto &coef : coefs) { coef = m_input->read_signed_int(size_t(precision)); }
+  std::array<int64_t, LpcKernels::MAX_ORDER> coefs{};
+  for (size_t i = 0; std::cmp_less(i, lpc_order); ++i) { coefs[i] = m_input.read_signed_int(size_t(precision)); }
 
   read_residuals(lpc_order, result);
-  restore_lpc(result, coefs, bit_depth, shift);
+  restore_lpc(result, { coefs.data(), size_t(lpc_order) }, bit_depth, shift);
 }
 
-void FrameDecoder::restore_lpc(std::vector<int64_t> &result,
-  const std::vector<int64_t> &coefs,
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::restore_lpc(std::vector<Sample> &result,
+  std::span<const int64_t> coefs,
   uint32_t bit_depth,
   int shift)
 {
@@ -210,59 +693,99 @@ void FrameDecoder::restore_lpc(std::vector<int64_t> &result,
   if (bit_depth < 1 || bit_depth > 33) { throw std::invalid_argument("bit_depth is invalid"); }
   if (shift < 0 || shift > 63) { throw std::invalid_argument("shift is invalid"); }
 
-  auto lower_bound = (-1) << (bit_depth - 1);// NOLINT
-  auto upper_bound = -(lower_bound + 1);
-
-  for (size_t i = coefs.size(); i < m_current_block_size.value_or(0); ++i) {
-    int64_t sum = 0;
-    for (size_t j = 0; j < coefs.size(); ++j) { sum += result.at(i - 1 - j) * coefs.at(j); }
-
-    assert((sum >> 53) == 0 || (sum >> 53) == -1);// NOLINT
-    sum = result.at(i) + (sum >> shift);// NOLINT
+  LpcKernels::restore({ result.data(), size_t(m_current_block_size.value_or(0)) }, coefs, shift, bit_depth);
+  check_restored(result, coefs.size(), bit_depth);
+}
 
-    if (sum < lower_bound || sum > upper_bound) { throw DataFormatException("Post-LPC result exceeds bit depth"); }
-    result.at(i) = sum;
+// The restore kernels run unchecked, a stream whose samples leave the bit depth is rejected here
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::check_restored(const std::vector<Sample> &result,
+  size_t order,
+  uint32_t bit_depth)
+{
+  const int64_t lower_bound = -(int64_t{ 1 } << (bit_depth - 1U));// NOLINT
+  const int64_t upper_bound = -(lower_bound + 1);
+  auto block_size = size_t(m_current_block_size.value_or(0));
+
+  if constexpr (Level == ValidationLevel::Strict) {
+    for (size_t i = order; i < block_size; ++i) {
+      if (result[i] < lower_bound || result[i] > upper_bound) {
+        throw DataFormatException("Post-LPC result exceeds bit depth");
+      }
+    }
+  } else if constexpr (Level == ValidationLevel::Checked) {
+    if (block_size > order) {
+      auto [min, max] = get_min_max(result.data() + order, block_size - order);
+      if (min < lower_bound || max > upper_bound) { throw DataFormatException("Post-LPC result exceeds bit depth"); }
+    }
   }
 }
 
-void FrameDecoder::read_residuals(int64_t warmup, std::vector<int64_t> &result)
+template<typename Input, ValidationLevel Level, typename Sample>
+void FrameDecoder<Input, Level, Sample>::read_residuals(int64_t warmup, std::vector<Sample> &result)
 {
   if (warmup < 0 || std::cmp_greater(warmup, m_current_block_size.value_or(0))) {
+    throw std::invalid_argument("warmup is invalid");
+  }
 
+  auto method = m_input.read_uint(2);
+  if (method >= 2) { throw DataFormatException("Reserved residual coding method"); }
+  assert(method == 0 || method == 1);
 
-    auto method = m_input->read_uint(2);
-    if (method >= 2) { throw DataFormatException("Reserved residual coding method"); }
-    assert(method == 0 || method == 1);
-
-    const int param_bits = method == 0 ? 4 : 5;
-    const int escape_param = method == 0 ? 0xF : 0x1F;
+  const int param_bits = method == 0 ? 4 : 5;
+  const int escape_param = method == 0 ? 0xF : 0x1F;
 
-    auto partition_order = m_input->read_uint(4);
-    const uint64_t num_partitions = 1U << static_cast<uint8_t>(partition_order);
+  auto partition_order = m_input.read_uint(4);
+  const uint64_t num_partitions = 1U << static_cast<uint8_t>(partition_order);
 
-    if (m_current_block_size.value_or(0) % num_partitions != 0) {
-      throw DataFormatException("Block size not divisible by number of Rice partitions");
-    }
+  if (m_current_block_size.value_or(0) % num_partitions != 0) {
+    throw DataFormatException("Block size not divisible by number of Rice partitions");
+  }
 
-    for (size_t inc = m_current_block_size.value_or(0) >> partition_order,// NOLINT
-      part_end = inc,
-                result_index = size_t(warmup);
-      part_end <= m_current_block_size.value_or(0);
-      part_end += inc) {
+  for (size_t inc = m_current_block_size.value_or(0) >> partition_order,// NOLINT
+    part_end = inc,
+              result_index = size_t(warmup);
+    part_end <= m_current_block_size.value_or(0);
+    part_end += inc) {
 
-      auto param = m_input->read_uint(size_t(param_bits));
+    auto param = m_input.read_uint(size_t(param_bits));
 
-      if (param == escape_param) {
-        auto num_bits = m_input->read_uint(5);
+    if (param == escape_param) {
+      auto num_bits = m_input.read_uint(5);
 
-        for (; result_index < part_end; result_index++) {
-          result.at(result_index) = m_input->read_signed_int(size_t(num_bits));
-        }
-      } else {
-        m_input->read_rice_signed_ints(size_t(param), result, result_index, part_end);
-        result_index = part_end;
+      for (; result_index < part_end; result_index++) {
+        result.at(result_index) = m_input.read_signed_int(size_t(num_bits));
       }
+    } else {
+      m_input.read_rice_signed_ints(size_t(param), result, result_index, part_end);
+      result_index = part_end;
     }
   }
 }
+
+template class FrameDecoder<ByteFlacInput, ValidationLevel::Strict, int64_t>;
+template class FrameDecoder<ByteFlacInput, ValidationLevel::Strict, int32_t>;
+template class FrameDecoder<ByteFlacInput, ValidationLevel::Checked, int64_t>;
+template class FrameDecoder<ByteFlacInput, ValidationLevel::Checked, int32_t>;
+template class FrameDecoder<ByteFlacInput, ValidationLevel::Trusted, int64_t>;
+template class FrameDecoder<ByteFlacInput, ValidationLevel::Trusted, int32_t>;
+template class FrameDecoder<SeekableFileFlacInput, ValidationLevel::Strict, int64_t>;
+template class FrameDecoder<SeekableFileFlacInput, ValidationLevel::Strict, int32_t>;
+template class FrameDecoder<SeekableFileFlacInput, ValidationLevel::Checked, int64_t>;
+template class FrameDecoder<SeekableFileFlacInput, ValidationLevel::Checked, int32_t>;
+template class FrameDecoder<SeekableFileFlacInput, ValidationLevel::Trusted, int64_t>;
+template class FrameDecoder<SeekableFileFlacInput, ValidationLevel::Trusted, int32_t>;
+template class FrameDecoder<MmapFlacInput, ValidationLevel::Strict, int64_t>;
+template class FrameDecoder<MmapFlacInput, ValidationLevel::Strict, int32_t>;
+template class FrameDecoder<MmapFlacInput, ValidationLevel::Checked, int64_t>;
+template class FrameDecoder<MmapFlacInput, ValidationLevel::Checked, int32_t>;
+template class FrameDecoder<MmapFlacInput, ValidationLevel::Trusted, int64_t>;
+template class FrameDecoder<MmapFlacInput, ValidationLevel::Trusted, int32_t>;
+template class FrameDecoder<ReadAheadFileFlacInput, ValidationLevel::Strict, int64_t>;
+template class FrameDecoder<ReadAheadFileFlacInput, ValidationLevel::Strict, int32_t>;
+template class FrameDecoder<ReadAheadFileFlacInput, ValidationLevel::Checked, int64_t>;
+template class FrameDecoder<ReadAheadFileFlacInput, ValidationLevel::Checked, int32_t>;
+template class FrameDecoder<ReadAheadFileFlacInput, ValidationLevel::Trusted, int64_t>;
+template class FrameDecoder<ReadAheadFileFlacInput, ValidationLevel::Trusted, int32_t>;
+
 }// namespace flac
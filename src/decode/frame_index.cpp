@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <flac_codec/common/crc.h>
+#include <flac_codec/decode/data_format_exception.h>
+#include <flac_codec/decode/flac_decoder.h>
+#include <flac_codec/decode/frame_index.h>
+#include <flac_codec/decode/frame_scanner.h>
+#include <flac_codec/decode/mmap_flac_input.h>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace flac {
+
+namespace {
+
+  // Sidecar layout, all fields little-endian uint64_t:
+  //   header: magic, FLAC file size, FLAC mtime in ns, frames, samples, checksum, frames per checkpoint
+  //   one checkpoint per group: sample offset, file offset, start of the group's varints
+  //   varints: file offset delta and sample offset delta of every frame that is not a checkpoint
+  // The last byte of the magic is the version. Version 1 sidecars could hold a truncated index, so they are rebuilt.
+  const std::array<uint8_t, 8> MAGIC{ 'F', 'L', 'A', 'C', 'I', 'D', 'X', 2 };
+  const size_t FLAC_SIZE_FIELD = 8;
+  const size_t FLAC_MTIME_FIELD = 16;
+  const size_t NUM_FRAMES_FIELD = 24;
+  const size_t NUM_SAMPLES_FIELD = 32;
+  const size_t CHECKSUM_FIELD = 40;
+  const size_t GROUP_SIZE_FIELD = 48;
+  const size_t HEADER_SIZE = 56;
+  const size_t CHECKPOINT_SIZE = 24;
+
+  const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325;
+  const uint64_t FNV_PRIME = 0x100000001B3;
+
+  uint64_t get_checksum(std::span<const uint8_t> data, uint64_t hash = FNV_OFFSET_BASIS)
+  {
+    for (const uint8_t byte : data) { hash = (hash ^ byte) * FNV_PRIME; }
+    return hash;
+  }
+
+  // Everything but the checksum field itself
+  uint64_t get_index_checksum(std::span<const uint8_t> data)
+  {
+    return get_checksum(data.subspan(CHECKSUM_FIELD + 8), get_checksum(data.first(CHECKSUM_FIELD)));
+  }
+
+  void put_field(std::vector<uint8_t> &data, size_t offset, uint64_t val)
+  {
+    for (size_t i = 0; i < 8; ++i) { data[offset + i] = static_cast<uint8_t>(val >> (8 * i)); }
+  }
+
+  void put_varint(std::vector<uint8_t> &data, uint64_t val)
+  {
+    while (val >= 0x80) {
+      data.push_back(static_cast<uint8_t>(val | 0x80U));
+      val >>= 7U;
+    }
+    data.push_back(static_cast<uint8_t>(val));
+  }
+
+  uint64_t get_varint(std::span<const uint8_t> data, size_t &pos)
+  {
+    uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (pos >= data.size()) { throw DataFormatException("Corrupt frame index"); }
+      auto byte = data[pos++];
+      result |= uint64_t{ byte & 0x7FU } << shift;
+      if ((byte & 0x80U) == 0) { return result; }
+    }
+    throw DataFormatException("Corrupt frame index");
+  }
+
+  // Size and modification time identify the version of the FLAC file an index was built for
+  std::pair<uint64_t, uint64_t> get_file_stamp(const std::string &filename)
+  {
+    struct stat status{};
+    if (::stat(filename.c_str(), &status) != 0) {
+      const std::string msg{ "Failed to stat " + filename + ": " + std::strerror(errno) };
+      throw std::runtime_error(msg);
+    }
+    auto mtime = static_cast<uint64_t>(status.st_mtim.tv_sec) * 1'000'000'000 + uint64_t(status.st_mtim.tv_nsec);
+    return { static_cast<uint64_t>(status.st_size), mtime };
+  }
+
+  uint64_t get_num_groups(uint64_t num_frames)
+  {
+    return (num_frames + FrameIndex::FRAMES_PER_CHECKPOINT - 1) / FrameIndex::FRAMES_PER_CHECKPOINT;
+  }
+
+  // An index is only worth saving if it covers the whole stream: the first frame starts the audio, the last one runs to
+  // the end of the file, which its CRC-16 being zero over that span shows, and no fewer samples than STREAMINFO states
+  void check_complete(std::span<const FrameLocation> frames, const std::string &flac_file)
+  {
+    FlacDecoder dec(flac_file, FlacDecoder::InputType::Mmap);
+    while (dec.read_and_handle_metadata_block().has_value()) {}
+    auto audio_start = dec.get_metadata_end_pos().value_or(0);
+    const MmapFlacInput input(flac_file);
+    auto data = input.get_data();
+
+    if (frames.empty()) {
+      if (audio_start == data.size()) { return; }
+      throw DataFormatException("No frames to index");
+    }
+    if (frames.front().m_file_offset != audio_start) { throw DataFormatException("Frames do not start the audio"); }
+    auto last = frames.back().m_file_offset;
+    if (last >= data.size() || Crc::update_crc16(0, data.subspan(last)) != 0) {
+      throw DataFormatException("Frames do not run to the end of the file");
+    }
+    auto num_samples = frames.back().m_sample_offset + frames.back().m_block_size;
+    if (dec.m_stream_info != nullptr && num_samples < dec.m_stream_info->m_num_samples) {
+      throw DataFormatException("Frames hold fewer samples than STREAMINFO states");
+    }
+  }
+
+}// namespace
+
+void FrameIndex::Unmap::operator()(const uint8_t *ptr) const
+{
+  ::munmap(const_cast<uint8_t *>(ptr), m_length);// NOLINT
+}
+
+FrameIndex FrameIndex::build(std::span<const FrameLocation> frames, const std::string &flac_file)
+{
+  for (size_t i = 1; i < frames.size(); ++i) {
+    if (frames[i].m_file_offset <= frames[i - 1].m_file_offset
+        || frames[i].m_sample_offset <= frames[i - 1].m_sample_offset) {
+      throw std::invalid_argument("Frames are not in stream order");
+    }
+  }
+  check_complete(frames, flac_file);
+
+  auto [size, mtime] = get_file_stamp(flac_file);
+  auto num_groups = get_num_groups(frames.size());
+  auto varint_start = HEADER_SIZE + num_groups * CHECKPOINT_SIZE;
+
+  FrameIndex result;
+  std::vector<uint8_t> &data = result.m_owned;
+  data.resize(varint_start);
+  std::copy(MAGIC.begin(), MAGIC.end(), data.begin());
+  put_field(data, FLAC_SIZE_FIELD, size);
+  put_field(data, FLAC_MTIME_FIELD, mtime);
+  put_field(data, NUM_FRAMES_FIELD, frames.size());
+  put_field(data, NUM_SAMPLES_FIELD, frames.empty() ? 0 : frames.back().m_sample_offset + frames.back().m_block_size);
+  put_field(data, GROUP_SIZE_FIELD, FRAMES_PER_CHECKPOINT);
+
+  for (size_t i = 0; i < frames.size(); ++i) {
+    if (i % FRAMES_PER_CHECKPOINT == 0) {
+      auto checkpoint = HEADER_SIZE + (i / FRAMES_PER_CHECKPOINT) * CHECKPOINT_SIZE;
+      put_field(data, checkpoint, frames[i].m_sample_offset);
+      put_field(data, checkpoint + 8, frames[i].m_file_offset);
+      put_field(data, checkpoint + 16, data.size() - varint_start);
+    } else {
+      put_varint(data, frames[i].m_file_offset - frames[i - 1].m_file_offset);
+      put_varint(data, frames[i].m_sample_offset - frames[i - 1].m_sample_offset);
+    }
+  }
+
+  put_field(data, CHECKSUM_FIELD, get_index_checksum(data));
+  result.m_data = data;
+  return result;
+}
+
+FrameIndex FrameIndex::build(const std::string &flac_file, uint64_t audio_start, unsigned num_threads)
+{
+  return build(FrameScanner::scan(flac_file, audio_start, num_threads), flac_file);
+}
+
+std::optional<FrameIndex> FrameIndex::load(const std::string &index_file, const std::string &flac_file)
+{
+  const int fd = ::open(index_file.c_str(), O_RDONLY | O_CLOEXEC);// NOLINT
+  if (fd < 0) { return std::nullopt; }
+
+  struct stat status{};
+  if (::fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < HEADER_SIZE) {
+    ::close(fd);
+    return std::nullopt;
+  }
+  auto length = static_cast<size_t>(status.st_size);
+  void *addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) { return std::nullopt; }// NOLINT
+
+  FrameIndex result;
+  result.m_mapping = std::unique_ptr<const uint8_t, Unmap>(static_cast<const uint8_t *>(addr), Unmap{ length });
+  result.m_data = { result.m_mapping.get(), length };
+
+  auto [size, mtime] = get_file_stamp(flac_file);
+  auto num_groups = get_num_groups(result.get_num_frames());
+  if (!std::equal(MAGIC.begin(), MAGIC.end(), result.m_data.begin()) || result.read_field(FLAC_SIZE_FIELD) != size
+      || result.read_field(FLAC_MTIME_FIELD) != mtime || result.read_field(GROUP_SIZE_FIELD) != FRAMES_PER_CHECKPOINT
+      || num_groups > (length - HEADER_SIZE) / CHECKPOINT_SIZE
+      || result.read_field(CHECKSUM_FIELD) != get_index_checksum(result.m_data)) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+FrameIndex FrameIndex::open(const std::string &flac_file, uint64_t audio_start, const std::string &index_file)
+{
+  auto loaded = load(index_file, flac_file);
+  if (loaded.has_value()) { return std::move(loaded.value()); }
+
+  auto result = build(flac_file, audio_start);
+  try {
+    result.save(index_file);
+  } catch (const std::runtime_error &) {
+    // A read-only location only costs the next open another scan
+  }
+  return result;
+}
+
+std::string FrameIndex::get_default_path(const std::string &flac_file) { return flac_file + ".fidx"; }
+
+void FrameIndex::save(const std::string &index_file) const
+{
+  // A unique name next to the index, so concurrent saves never write into the same file and the rename stays on one
+  // file system
+  std::string temp_file = index_file + ".XXXXXX";
+  const int fd = ::mkstemp(temp_file.data());
+  if (fd < 0) { throw std::runtime_error("Failed to create " + temp_file + ": " + std::strerror(errno)); }
+
+  // mkstemp creates the file private to the owner, an index is as readable as any other cache file
+  bool written = ::fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0;
+  for (size_t total = 0; written && total < m_data.size();) {
+    auto res = ::write(fd, m_data.data() + total, m_data.size() - total);// NOLINT
+    if (res < 0 && errno == EINTR) { continue; }
+    written = res > 0;
+    if (written) { total += static_cast<size_t>(res); }
+  }
+  written = ::close(fd) == 0 && written;
+  if (!written) {
+    std::remove(temp_file.c_str());
+    throw std::runtime_error("Failed to write " + temp_file);
+  }
+  if (std::rename(temp_file.c_str(), index_file.c_str()) != 0) {
+    std::remove(temp_file.c_str());
+    throw std::runtime_error("Failed to rename " + temp_file + " to " + index_file);
+  }
+}
+
+size_t FrameIndex::get_num_frames() const { return read_field(NUM_FRAMES_FIELD); }
+
+uint64_t FrameIndex::get_num_samples() const { return read_field(NUM_SAMPLES_FIELD); }
+
+std::optional<FrameLocation> FrameIndex::find(uint64_t sample) const
+{
+  auto num_frames = get_num_frames();
+  auto num_samples = get_num_samples();
+  if (num_frames == 0 || sample >= num_samples) { return std::nullopt; }
+
+  // Last checkpoint at or before sample; the first one is always sample 0 or earlier
+  size_t low = 0;
+  size_t high = get_num_groups(num_frames);
+  while (high - low > 1) {
+    auto mid = (low + high) / 2;
+    if (read_field(HEADER_SIZE + mid * CHECKPOINT_SIZE) <= sample) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+
+  auto checkpoint = HEADER_SIZE + low * CHECKPOINT_SIZE;
+  FrameLocation cur{ read_field(checkpoint + 8), read_field(checkpoint), 0 };
+  auto varint_start = HEADER_SIZE + get_num_groups(num_frames) * CHECKPOINT_SIZE;
+  auto pos = varint_start + read_field(checkpoint + 16);
+
+  auto first = low * FRAMES_PER_CHECKPOINT;
+  auto last = std::min<size_t>(first + FRAMES_PER_CHECKPOINT, num_frames);
+  for (auto idx = first; idx + 1 < last; ++idx) {
+    auto file_offset = cur.m_file_offset + get_varint(m_data, pos);
+    auto sample_offset = cur.m_sample_offset + get_varint(m_data, pos);
+    if (sample_offset > sample) {
+      cur.m_block_size = static_cast<uint32_t>(sample_offset - cur.m_sample_offset);
+      return cur;
+    }
+    cur = { file_offset, sample_offset, 0 };
+  }
+
+  // The group's last frame ends where the next group or the stream does
+  auto end = last < num_frames ? read_field(checkpoint + CHECKPOINT_SIZE) : num_samples;
+  cur.m_block_size = static_cast<uint32_t>(end - cur.m_sample_offset);
+  return cur;
+}
+
+uint64_t FrameIndex::read_field(size_t offset) const
+{
+  if (offset + 8 > m_data.size()) { throw DataFormatException("Corrupt frame index"); }
+  uint64_t result = 0;
+  for (size_t i = 0; i < 8; ++i) { result |= uint64_t{ m_data[offset + i] } << (8 * i); }
+  return result;
+}
+
+}// namespace flac
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <flac_codec/common/crc.h>
+#include <flac_codec/common/frame_info.h>
+#include <flac_codec/decode/data_format_exception.h>
+#include <flac_codec/decode/frame_scanner.h>
+#include <flac_codec/decode/mmap_flac_input.h>
+#include <flac_codec/decode/sync_kernels.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flac {
+
+namespace {
+
+  // Below this a chunk is not worth a thread of its own
+  const size_t MIN_CHUNK_SIZE = 1U << 20U;
+
+  struct Candidate
+  {
+    uint64_t m_file_offset;
+    uint64_t m_position;// Frame index for fixed-size blocks, sample offset for variable-size ones
+    uint32_t m_block_size;
+    bool m_variable;
+  };
+
+  // Every sync code starting in [begin, end) whose header parses and passes its CRC-8
+  std::vector<Candidate> find_candidates(MmapFlacInput &input, size_t begin, size_t end)
+  {
+    auto data = input.get_data();
+    auto window = data.subspan(begin, std::min(end + SyncKernels::MAX_HEADER_SIZE - 1, data.size()) - begin);
+    std::vector<size_t> offsets;
+    SyncKernels::find_headers(window, end - begin, offsets);
+
+    std::vector<Candidate> result;
+    for (const size_t offset : offsets) {
+      input.seek_to(begin + offset);
+      try {
+        auto frame = FrameInfo::read_frame(input);
+        if (!frame.has_value()) { continue; }
+        const bool variable = frame->m_sample_offset.has_value();
+        auto position = variable ? frame->m_sample_offset.value() : uint64_t{ frame->m_frame_index.value_or(0) };
+        result.push_back({ begin + offset, position, frame->m_block_size.value_or(0), variable });
+      } catch (const std::runtime_error &) {
+        // Checked the same way already, only a header the kernels and FrameInfo disagree on gets here
+      }
+    }
+    return result;
+  }
+
+  // Follows the chain of positions from the frame at audio_start, skipping candidates that do not continue it
+  std::vector<FrameLocation> link_frames(const std::vector<std::vector<Candidate>> &chunks, uint64_t audio_start)
+  {
+    std::vector<FrameLocation> result;
+    const Candidate *prev = nullptr;
+    uint64_t fixed_block_size = 0;
+
+    for (const auto &chunk : chunks) {
+      for (const Candidate &cand : chunk) {
+        if (prev == nullptr) {
+          if (cand.m_file_offset != audio_start) { continue; }
+          fixed_block_size = cand.m_block_size;
+        } else {
+          auto expected = prev->m_variable ? prev->m_position + prev->m_block_size : prev->m_position + 1;
+          if (cand.m_variable != prev->m_variable || cand.m_position != expected) { continue; }
+        }
+
+        auto sample_offset = cand.m_variable ? cand.m_position : cand.m_position * fixed_block_size;
+        result.push_back({ cand.m_file_offset, sample_offset, cand.m_block_size });
+        prev = &cand;
+      }
+    }
+    return result;
+  }
+
+}// namespace
+
+std::vector<FrameLocation> FrameScanner::scan(const std::string &filename, uint64_t audio_start, unsigned num_threads)
+{
+  if (num_threads == 0) { num_threads = std::max(1U, std::thread::hardware_concurrency()); }
+
+  MmapFlacInput input(filename);
+  auto length = input.get_length();
+  if (audio_start > length) { throw std::invalid_argument("Audio start is past the end of the file"); }
+  if (audio_start == length) { return {}; }
+
+  auto num_chunks = std::clamp<size_t>((length - audio_start) / MIN_CHUNK_SIZE, 1, num_threads);
+  auto chunk_size = (length - audio_start + num_chunks - 1) / num_chunks;
+  std::vector<std::vector<Candidate>> chunks(num_chunks);
+  std::vector<std::exception_ptr> errors(num_chunks);
+
+  auto scan_chunk = [&](size_t idx, MmapFlacInput &chunk_input) {
+    auto begin = audio_start + idx * chunk_size;
+    auto end = std::min<uint64_t>(begin + chunk_size, length);
+    try {
+      chunks[idx] = find_candidates(chunk_input, begin, end);
+    } catch (...) {
+      errors[idx] = std::current_exception();
+    }
+  };
+
+  {
+    // Each thread maps the file itself, the bit reader position is per input
+    std::vector<std::jthread> workers;
+    for (size_t idx = 1; idx < num_chunks; ++idx) {
+      workers.emplace_back([&, idx] {
+        try {
+          MmapFlacInput chunk_input(filename);
+          scan_chunk(idx, chunk_input);
+        } catch (...) {
+          errors[idx] = std::current_exception();
+        }
+      });
+    }
+    scan_chunk(0, input);
+  }
+
+  for (const auto &error : errors) {
+    if (error) { std::rethrow_exception(error); }
+  }
+
+  auto result = link_frames(chunks, audio_start);
+  if (result.empty()) { throw DataFormatException("No frame at the start of the audio"); }
+
+  // The CRC-16 over a whole frame, footer included, is zero. A damaged or missing frame breaks the chain, and every
+  // frame after it is skipped, so the last one linked then spans the rest of the file and the CRC does not match.
+  auto tail = input.get_data().subspan(result.back().m_file_offset);
+  if (Crc::update_crc16(0, tail) != 0) {
+    throw DataFormatException(
+      "Frame chain breaks after the frame at offset " + std::to_string(result.back().m_file_offset));
+  }
+  return result;
+}
+
+}// namespace flac
@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/common/stream_info.h>
+#include <flac_codec/decode/flac_decoder.h>
+#include <flac_codec/decode/frame_decoder.h>
+#include <flac_codec/decode/frame_scanner.h>
+#include <flac_codec/decode/loudness_analyzer.h>
+#include <flac_codec/decode/parallel_flac_decoder.h>
+#include <flac_codec/decode/sample_buffer.h>
+#include <iterator>
+#include <numbers>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FLAC_CODEC_HAS_AVX2 1
+#endif
+
+namespace flac {
+
+namespace {
+
+  const size_t BLOCK_STEPS = 4;
+  const double ABSOLUTE_GATE = -70.0;
+  const double RELATIVE_GATE = -10.0;
+  const double BIN_WIDTH = 0.01;
+  // Up to +30 LUFS, well above what K-weighted full-scale audio reaches on 8 channels
+  const size_t NUM_BINS = 10000;
+  const double REPLAY_GAIN_REFERENCE = -18.0;
+
+  // 4x oversampling as BS.1770 asks for: a Hann-windowed sinc of 48 taps, split into phases of 12. Phase 0 gives back
+  // the samples themselves, which the sample peak covers, so only the 3 phases between samples are kept.
+  const size_t OVERSAMPLING = 4;
+  const size_t TAPS_PER_PHASE = 12;
+  using TruePeakPhases = std::array<std::array<double, TAPS_PER_PHASE>, OVERSAMPLING - 1>;
+
+  TruePeakPhases make_true_peak_phases()
+  {
+    const double center = double(TAPS_PER_PHASE * OVERSAMPLING) / 2;
+    TruePeakPhases phases{};
+    for (size_t p = 1; p < OVERSAMPLING; ++p) {
+      double sum = 0;
+      for (size_t j = 0; j < TAPS_PER_PHASE; ++j) {
+        auto k = double(p + j * OVERSAMPLING) - center;
+        auto t = std::numbers::pi * k / OVERSAMPLING;
+        auto window = 0.5 * (1 + std::cos(std::numbers::pi * k / center));
+        phases.at(p - 1).at(j) = std::sin(t) / t * window;
+        sum += phases.at(p - 1).at(j);
+      }
+      // Unity gain at DC, so a constant signal peaks at its own level
+      for (double &tap : phases.at(p - 1)) { tap /= sum; }
+    }
+    return phases;
+  }
+
+  const TruePeakPhases TRUE_PEAK_PHASES = make_true_peak_phases();
+
+  // No phase can exceed the largest input sample in its reach by more than this
+  const double TRUE_PEAK_GAIN = [] {
+    double gain = 0;
+    for (const auto &phase : TRUE_PEAK_PHASES) {
+      double sum = 0;
+      for (double tap : phase) { sum += std::abs(tap); }
+      gain = std::max(gain, sum);
+    }
+    return gain;
+  }();
+
+  // Largest interpolated value between the n samples at x and the ones before them
+  double interpolate_peak(const double *x, size_t n)
+  {
+    double peak = 0;
+    for (size_t i = 0; i < n; ++i) {
+      const double *at = x + i;// NOLINT
+      for (const auto &phase : TRUE_PEAK_PHASES) {
+        double y = 0;
+        for (size_t j = 0; j < TAPS_PER_PHASE; ++j) { y += phase[j] * at[-static_cast<ptrdiff_t>(j)]; }// NOLINT
+        peak = std::max(peak, std::abs(y));
+      }
+    }
+    return peak;
+  }
+
+#ifdef FLAC_CODEC_HAS_AVX2
+  // Eight outputs per phase in two registers, each tap a broadcast and two multiply-adds. Whole groups are computed,
+  // and the values past n, which come from stale samples, are left out when reducing.
+  template<size_t Chunk> __attribute__((target("avx2,fma"))) double interpolate_peak_avx2(const double *x, size_t n)
+  {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    std::array<double, Chunk> peaks{};
+    for (size_t i = 0; i < Chunk; i += 8) {
+      const double *at = x + i;// NOLINT
+      __m256d peak0 = _mm256_setzero_pd();
+      __m256d peak1 = _mm256_setzero_pd();
+      for (const auto &phase : TRUE_PEAK_PHASES) {
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        for (size_t j = 0; j < TAPS_PER_PHASE; ++j) {
+          const __m256d tap = _mm256_set1_pd(phase[j]);
+          const auto back = static_cast<ptrdiff_t>(j);
+          acc0 = _mm256_fmadd_pd(tap, _mm256_loadu_pd(at - back), acc0);// NOLINT
+          acc1 = _mm256_fmadd_pd(tap, _mm256_loadu_pd(at + 4 - back), acc1);// NOLINT
+        }
+        peak0 = _mm256_max_pd(peak0, _mm256_andnot_pd(sign, acc0));
+        peak1 = _mm256_max_pd(peak1, _mm256_andnot_pd(sign, acc1));
+      }
+      _mm256_storeu_pd(peaks.data() + i, peak0);// NOLINT
+      _mm256_storeu_pd(peaks.data() + i + 4, peak1);// NOLINT
+    }
+    return *std::max_element(peaks.begin(), peaks.begin() + long(n));
+  }
+
+  bool has_avx2()
+  {
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+  }
+#endif
+
+  template<size_t Chunk> double interpolate_peak_fastest(const double *x, size_t n)
+  {
+#ifdef FLAC_CODEC_HAS_AVX2
+    if (has_avx2()) { return interpolate_peak_avx2<Chunk>(x, n); }
+#endif
+    return interpolate_peak(x, n);
+  }
+
+  // FLAC's channel order: the LFE does not count and surround channels weigh 1.41
+  double get_channel_weight(uint32_t num_channels, size_t ch)
+  {
+    if (num_channels == 4) { return ch >= 2 ? 1.41 : 1.0; }
+    if (num_channels == 5) { return ch >= 3 ? 1.41 : 1.0; }
+    if (num_channels >= 6) {
+      if (ch == 3) { return 0.0; }
+      return ch > 3 ? 1.41 : 1.0;
+    }
+    return 1.0;
+  }
+
+  double to_loudness(double energy) { return -0.691 + 10 * std::log10(energy); }
+
+}// namespace
+
+LoudnessAnalyzer::LoudnessAnalyzer(uint32_t sample_rate,
+  uint32_t num_channels,
+  uint32_t bit_depth,
+  uint64_t first_sample)
+  : m_sample_rate(sample_rate), m_step_size((sample_rate + 5) / 10), m_scale(std::ldexp(1.0, 1 - int(bit_depth))),
+    m_first_sample(first_sample), m_position(first_sample), m_channels(num_channels), m_histogram(NUM_BINS)
+{
+  // The K-weighting shelf sits at 1.7 kHz, which needs room below Nyquist
+  if (sample_rate < 8000) { throw std::invalid_argument("Loudness needs a sample rate of at least 8 kHz"); }
+  if (num_channels == 0 || num_channels > SampleBuffer::MAX_CHANNELS) {
+    throw std::invalid_argument("Unsupported number of channels");
+  }
+
+  // BS.1770's two stages, designed for this sample rate: a high shelf modelling the head, then the RLB high-pass
+  const double rate = sample_rate;
+  auto k = std::tan(std::numbers::pi * 1681.974450955533 / rate);
+  auto q = 0.7071752369554196;
+  auto vh = std::pow(10.0, 3.999843853973347 / 20);
+  auto vb = std::pow(vh, 0.4996667741545416);
+  auto a0 = 1 + k / q + k * k;
+  const Biquad shelf{ (vh + vb * k / q + k * k) / a0,
+    2 * (k * k - vh) / a0,
+    (vh - vb * k / q + k * k) / a0,
+    2 * (k * k - 1) / a0,
+    (1 - k / q + k * k) / a0 };
+
+  k = std::tan(std::numbers::pi * 38.13547087602444 / rate);
+  q = 0.5003270373238773;
+  a0 = 1 + k / q + k * k;
+  const Biquad high_pass{ 1, -2, 1, 2 * (k * k - 1) / a0, (1 - k / q + k * k) / a0 };
+
+  m_k_weighting = { shelf, high_pass };
+  for (size_t ch = 0; ch < num_channels; ++ch) {
+    m_channels[ch].m_weight = get_channel_weight(num_channels, ch);
+  }
+}
+
+void LoudnessAnalyzer::warm_up(const SampleBuffer &block, size_t num_frames)
+{
+  if (m_position != m_first_sample) { throw std::runtime_error("Warm-up after samples were measured"); }
+  process<false>(block, 0, num_frames);
+}
+
+void LoudnessAnalyzer::add(const SampleBuffer &block, size_t num_frames)
+{
+  // Split at step boundaries, so every run adds to a single step
+  for (size_t done = 0; done < num_frames;) {
+    auto index = m_position / m_step_size;
+    auto len = size_t(std::min<uint64_t>(num_frames - done, (index + 1) * m_step_size - m_position));
+    add_to_step(index, process<true>(block, done, len), uint32_t(len));
+    m_position += len;
+    done += len;
+  }
+}
+
+void LoudnessAnalyzer::merge(const LoudnessAnalyzer &next)
+{
+  if (next.m_first_sample != m_position || next.m_sample_rate != m_sample_rate || next.m_scale != m_scale
+      || next.m_channels.size() != m_channels.size()) {
+    throw std::invalid_argument("Merged analyzers must cover adjacent ranges of one stream");
+  }
+
+  // Both sides' edges in order, a step cut by the boundary summed from its two parts
+  auto left = get_edge_steps();
+  auto right = next.get_edge_steps();
+  std::vector<Step> steps;
+  std::ranges::merge(left, right, std::back_inserter(steps), {}, &Step::m_index, &Step::m_index);
+  for (size_t i = 1; i < steps.size(); ++i) {
+    if (steps[i].m_index == steps[i - 1].m_index) {
+      steps[i - 1].m_energy += steps[i].m_energy;
+      steps[i - 1].m_count += steps[i].m_count;
+      steps.erase(steps.begin() + long(i--));
+    }
+  }
+
+  // Only blocks that neither side could complete on its own are new
+  auto full_in = [this](const std::vector<Step> &side, uint64_t first) {
+    for (uint64_t index = first; index < first + BLOCK_STEPS; ++index) {
+      auto it = std::ranges::find(side, index, &Step::m_index);
+      if (it == side.end() || it->m_count != m_step_size) { return false; }
+    }
+    return true;
+  };
+  for (size_t i = 0; i + BLOCK_STEPS <= steps.size(); ++i) {
+    auto first = steps[i].m_index;
+    if (is_full_block(&steps[i]) && !full_in(left, first) && !full_in(right, first)) {
+      double energy = 0;
+      for (size_t s = i; s < i + BLOCK_STEPS; ++s) { energy += steps[s].m_energy; }
+      add_block(energy / double(BLOCK_STEPS * m_step_size));
+    }
+  }
+
+  for (size_t bin = 0; bin < NUM_BINS; ++bin) {
+    m_histogram[bin].m_count += next.m_histogram[bin].m_count;
+    m_histogram[bin].m_energy += next.m_histogram[bin].m_energy;
+  }
+  m_sample_peak = std::max(m_sample_peak, next.m_sample_peak);
+  m_true_peak = std::max(m_true_peak, next.m_true_peak);
+  m_channels = next.m_channels;
+  m_position = next.m_position;
+
+  // The step at the new end may still grow, so it is not one of the finished ones the head keeps
+  m_head.clear();
+  for (const Step &step : steps) {
+    if (m_head.size() == BLOCK_STEPS || step.m_index >= m_position / m_step_size) { break; }
+    m_head.push_back(step);
+  }
+  m_tail.assign(steps.end() - long(std::min(BLOCK_STEPS, steps.size())), steps.end());
+}
+
+LoudnessResult LoudnessAnalyzer::get_result() const
+{
+  LoudnessResult result{ std::nullopt, m_sample_peak, std::max(m_sample_peak, m_true_peak), std::nullopt };
+
+  // Blocks under the absolute gate never made it into the histogram
+  uint64_t count = 0;
+  double energy = 0;
+  for (const Bin &bin : m_histogram) {
+    count += bin.m_count;
+    energy += bin.m_energy;
+  }
+  if (count == 0) { return result; }
+
+  auto threshold = to_loudness(energy / double(count)) + RELATIVE_GATE;
+  auto first_bin = threshold <= ABSOLUTE_GATE ? 0 : size_t((threshold - ABSOLUTE_GATE) / BIN_WIDTH);
+  count = 0;
+  energy = 0;
+  for (size_t bin = std::min(first_bin, NUM_BINS - 1); bin < NUM_BINS; ++bin) {
+    count += m_histogram[bin].m_count;
+    energy += m_histogram[bin].m_energy;
+  }
+  if (count == 0) { return result; }
+
+  result.m_integrated_loudness = to_loudness(energy / double(count));
+  result.m_track_gain = REPLAY_GAIN_REFERENCE - result.m_integrated_loudness.value();
+  return result;
+}
+
+LoudnessResult LoudnessAnalyzer::analyze(FlacDecoder &dec)
+{
+  if (dec.m_stream_info == nullptr) { throw std::runtime_error("Metadata blocks not fully consumed yet"); }
+  const StreamInfo &info = *dec.m_stream_info;
+  LoudnessAnalyzer analyzer(info.m_sample_rate, info.m_num_channels, info.m_bit_depth);
+
+  std::vector<int32_t> samples(size_t(info.m_max_block_size) * info.m_num_channels);
+  auto block = SampleBuffer::interleaved(samples, info.m_num_channels);
+  for (uint32_t len = 0; (len = dec.read_audio_block(block, 0)) != 0;) { analyzer.add(block, len); }
+  return analyzer.get_result();
+}
+
+LoudnessResult LoudnessAnalyzer::analyze(const std::string &file_name, ValidationLevel validation, unsigned num_threads)
+{
+  if (num_threads == 0) { num_threads = std::max(1U, std::thread::hardware_concurrency()); }
+  ParallelFlacDecoder dec(file_name, validation, num_threads);
+  const StreamInfo &info = dec.get_stream_info();
+  const auto &frames = dec.get_frames();
+
+  auto frames_per_range = std::max<size_t>(1, (frames.size() + num_threads - 1) / num_threads);
+  std::vector<LoudnessAnalyzer> ranges;
+  ranges.emplace_back(info.m_sample_rate, info.m_num_channels, info.m_bit_depth);
+  for (size_t first = frames_per_range; first < frames.size(); first += frames_per_range) {
+    ranges.emplace_back(info.m_sample_rate, info.m_num_channels, info.m_bit_depth, frames[first].m_sample_offset);
+  }
+
+  // Enough frames before every range to cover the warm-up, whatever their block sizes
+  auto warm_up = uint64_t{ info.m_sample_rate } * WARM_UP_MS / 1000;
+  size_t lead_in = 0;
+  for (size_t first = frames_per_range; first < frames.size(); first += frames_per_range) {
+    size_t count = 0;
+    while (count < first && frames[first].m_sample_offset - frames[first - count].m_sample_offset < warm_up) {
+      ++count;
+    }
+    lead_in = std::max(lead_in, count);
+  }
+
+  dec.visit_ranges(frames_per_range,
+    lead_in,
+    [&](size_t range, const FrameLocation &frame, const SampleBuffer &block, bool is_lead_in) {
+      if (is_lead_in) {
+        ranges[range].warm_up(block, frame.m_block_size);
+      } else {
+        ranges[range].add(block, frame.m_block_size);
+      }
+    });
+
+  for (size_t range = 1; range < ranges.size(); ++range) { ranges[0].merge(ranges[range]); }
+  return ranges[0].get_result();
+}
+
+template<bool Measure> double LoudnessAnalyzer::process(const SampleBuffer &block, size_t offset, size_t len)
+{
+  double energy = 0;
+  for (size_t done = 0; done < len; done += CHUNK) {
+    auto n = std::min(CHUNK, len - done);
+    for (size_t ch = 0; ch < m_channels.size(); ++ch) {
+      const int32_t *src = block.channels.at(ch) + (offset + done) * block.stride;
+      double *x = m_channels[ch].m_window.data() + HISTORY;
+      for (size_t i = 0; i < n; ++i) { x[i] = src[i * block.stride] * m_scale; }// NOLINT
+    }
+
+    size_t ch = 0;
+    for (; ch + 2 <= m_channels.size(); ch += 2) { energy += filter<2>(&m_channels[ch], n); }
+    if (ch < m_channels.size()) { energy += filter<1>(&m_channels[ch], n); }
+
+    for (Channel &channel : m_channels) {
+      auto &window = channel.m_window;
+      if constexpr (Measure) {
+        const double *x = window.data() + HISTORY;
+        double peak = 0;
+        for (size_t i = 0; i < n; ++i) { peak = std::max(peak, std::abs(x[i])); }// NOLINT
+        m_sample_peak = std::max(m_sample_peak, peak);
+        for (size_t i = 0; i < HISTORY; ++i) { peak = std::max(peak, std::abs(window[i])); }
+
+        // Interpolating is by far the most expensive part, and skipped where it cannot raise the true peak
+        if (peak * TRUE_PEAK_GAIN > m_true_peak) {
+          m_true_peak = std::max(m_true_peak, interpolate_peak_fastest<CHUNK>(x, n));
+        }
+      }
+      std::copy(window.begin() + long(n), window.begin() + long(n + HISTORY), window.begin());
+    }
+  }
+  return energy;
+}
+
+template<size_t Count> double LoudnessAnalyzer::filter(Channel *channels, size_t n) const
+{
+  // Transposed direct form II, with the state in registers for the whole chunk
+  const auto [s0, s1, s2, sa1, sa2] = m_k_weighting[0];
+  const auto [h0, h1, h2, ha1, ha2] = m_k_weighting[1];
+  // One array per state value, so the channels line up as lanes when the compiler vectorizes across them
+  std::array<double, Count> sz1{};
+  std::array<double, Count> sz2{};
+  std::array<double, Count> hz1{};
+  std::array<double, Count> hz2{};
+  std::array<double, Count> sum{};
+  for (size_t c = 0; c < Count; ++c) {
+    const auto &state = channels[c].m_state;// NOLINT
+    sz1[c] = state[0];
+    sz2[c] = state[1];
+    hz1[c] = state[2];
+    hz2[c] = state[3];
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t c = 0; c < Count; ++c) {
+      const double x = channels[c].m_window[HISTORY + i];// NOLINT
+      // The terms that do not depend on the output come first, which shortens the loop-carried chain
+      auto y = s0 * x + sz1[c];
+      sz1[c] = (s1 * x + sz2[c]) - sa1 * y;
+      sz2[c] = s2 * x - sa2 * y;
+      auto z = h0 * y + hz1[c];
+      hz1[c] = (h1 * y + hz2[c]) - ha1 * z;
+      hz2[c] = h2 * y - ha2 * z;
+      sum[c] += z * z;
+    }
+  }
+
+  double energy = 0;
+  for (size_t c = 0; c < Count; ++c) {
+    channels[c].m_state = { sz1[c], sz2[c], hz1[c], hz2[c] };// NOLINT
+    energy += channels[c].m_weight * sum[c];// NOLINT
+  }
+  return energy;
+}
+
+void LoudnessAnalyzer::add_to_step(uint64_t index, double energy, uint32_t count)
+{
+  if (m_tail.empty() || m_tail.back().m_index != index) {
+    if (!m_tail.empty() && m_head.size() < BLOCK_STEPS) { m_head.push_back(m_tail.back()); }
+    m_tail.push_back({ index, 0, 0 });
+    if (m_tail.size() > BLOCK_STEPS) { m_tail.erase(m_tail.begin()); }
+  }
+
+  Step &step = m_tail.back();
+  step.m_energy += energy;
+  step.m_count += count;
+  if (m_tail.size() == BLOCK_STEPS && is_full_block(m_tail.data())) {
+    double sum = 0;
+    for (const Step &s : m_tail) { sum += s.m_energy; }
+    add_block(sum / double(BLOCK_STEPS * m_step_size));
+  }
+}
+
+void LoudnessAnalyzer::add_block(double energy)
+{
+  if (energy <= 0) { return; }
+  auto loudness = to_loudness(energy);
+  if (loudness <= ABSOLUTE_GATE) { return; }
+  Bin &bin = m_histogram[std::min(NUM_BINS - 1, size_t((loudness - ABSOLUTE_GATE) / BIN_WIDTH))];
+  ++bin.m_count;
+  bin.m_energy += energy;
+}
+
+bool LoudnessAnalyzer::is_full_block(const Step *first) const
+{
+  for (size_t s = 0; s < BLOCK_STEPS; ++s) {
+    if (first[s].m_index != first[0].m_index + s || first[s].m_count != m_step_size) { return false; }// NOLINT
+  }
+  return true;
+}
+
+std::vector<LoudnessAnalyzer::Step> LoudnessAnalyzer::get_edge_steps() const
+{
+  // A step in both is the same one, and the tail's copy is the latest
+  std::vector<Step> steps;
+  for (const Step &step : m_head) {
+    if (m_tail.empty() || step.m_index < m_tail.front().m_index) { steps.push_back(step); }
+  }
+  steps.insert(steps.end(), m_tail.begin(), m_tail.end());
+  return steps;
+}
+
+}// namespace flac
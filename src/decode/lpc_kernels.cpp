@@ -0,0 +1,276 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/decode/lpc_kernels.h>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FLAC_CODEC_HAS_AVX2 1
+#endif
+
+namespace flac {
+
+namespace {
+
+  template<typename Sample> using Kernel = void (*)(Sample *data, size_t len, const int64_t *coefs, int shift);
+
+  // Adds the prediction to the residual in the wider of the two types, unsigned so that it wraps like the sums. The
+  // low bits are the sample; the kernels feed the wide value back as is, which saves a sign extension on the
+  // recurrence for int32_t samples and only differs from the stored sample for a stream that is corrupt anyway.
+  template<typename Sample, typename Acc> inline auto add_prediction(Sample residual, Acc sum, int shift)
+  {
+    using Wide = std::conditional_t<(sizeof(Acc) > sizeof(Sample)), Acc, std::make_unsigned_t<Sample>>;
+    auto prediction = static_cast<std::make_signed_t<Acc>>(sum) >> shift;// NOLINT
+    return static_cast<Wide>(static_cast<Wide>(residual) + static_cast<Wide>(prediction));
+  }
+
+  // Acc is unsigned so that a corrupt stream wraps instead of overflowing; valid streams never wrap.
+  // From order 4 up the 4 newest samples are carried in registers: reloading a sample stored an iteration or two
+  // earlier puts a store-to-load forward on the critical path, or a stall once the compiler merges the loads.
+  template<size_t Order, typename Acc, typename Sample>
+  void restore_scalar(Sample *data, size_t len, const int64_t *coefs, int shift)
+  {
+    if constexpr (Order > 0 && Order < 4) {
+      std::array<Acc, Order> coef{};
+      for (size_t j = 0; j < Order; ++j) { coef[j] = static_cast<Acc>(coefs[j]); }
+      for (size_t i = Order; i < len; ++i) {
+        Acc sum = 0;
+        for (size_t j = 0; j < Order; ++j) { sum += coef[j] * static_cast<Acc>(data[i - 1 - j]); }
+        data[i] = static_cast<Sample>(add_prediction(data[i], sum, shift));
+      }
+    } else if constexpr (Order >= 4) {
+      std::array<Acc, Order> coef{};
+      for (size_t j = 0; j < Order; ++j) { coef[j] = static_cast<Acc>(coefs[j]); }
+      auto x1 = static_cast<Acc>(data[Order - 1]);
+      auto x2 = static_cast<Acc>(data[Order - 2]);
+      auto x3 = static_cast<Acc>(data[Order - 3]);
+      auto x4 = static_cast<Acc>(data[Order - 4]);
+      for (size_t i = Order; i < len; ++i) {
+        Acc sum = 0;
+        for (size_t j = 4; j < Order; ++j) { sum += coef[j] * static_cast<Acc>(data[i - 1 - j]); }
+        sum += coef[0] * x1 + coef[1] * x2 + coef[2] * x3 + coef[3] * x4;
+        auto value = add_prediction(data[i], sum, shift);
+        data[i] = static_cast<Sample>(value);
+        x4 = x3;
+        x3 = x2;
+        x2 = x1;
+        x1 = static_cast<Acc>(value);
+      }
+    }
+  }
+
+  template<typename Acc, typename Sample, size_t... Orders>
+  consteval std::array<Kernel<Sample>, sizeof...(Orders)> make_scalar_kernels(std::index_sequence<Orders...> /*orders*/)
+  {
+    return { &restore_scalar<Orders, Acc, Sample>... };
+  }
+
+  const size_t NUM_KERNELS = LpcKernels::MAX_ORDER + 1;
+  template<typename Acc, typename Sample>
+  constexpr auto SCALAR_KERNELS = make_scalar_kernels<Acc, Sample>(std::make_index_sequence<NUM_KERNELS>());
+
+  // state[j] is the j-th backward difference at the newest sample. Each residual is the Order-th difference, so
+  // adding it in and cascading down the differences yields the next sample with Order adds and no multiplies.
+  // Wrapping at the sample width is exact, as every valid sample fits in it.
+  template<size_t Order, typename Sample> void restore_fixed_order(Sample *data, size_t len)
+  {
+    using Acc = std::make_unsigned_t<Sample>;
+    std::array<Acc, Order> warmup{};
+    for (size_t j = 0; j < Order; ++j) { warmup[j] = static_cast<Acc>(data[j]); }
+    std::array<Acc, Order> state{};
+    state[0] = warmup[Order - 1];
+    for (size_t level = 1; level < Order; ++level) {
+      for (size_t j = Order - 1; j >= level; --j) { warmup[j] -= warmup[j - 1]; }
+      state[level] = warmup[Order - 1];
+    }
+
+    for (size_t i = Order; i < len; ++i) {
+      state[Order - 1] += static_cast<Acc>(data[i]);
+      for (size_t j = Order - 1; j > 0; --j) { state[j - 1] += state[j]; }
+      data[i] = static_cast<Sample>(state[0]);
+    }
+  }
+
+  const size_t AVX2_MIN_ORDER = 8;
+
+#ifdef FLAC_CODEC_HAS_AVX2
+  // Loads 4 samples into the low halves of 64-bit lanes, which is all _mm256_mul_epi32 reads
+  template<typename Sample> __attribute__((target("avx2"))) inline __m256i load_samples(const Sample *src)
+  {
+    if constexpr (sizeof(Sample) == 8) {
+      return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));// NOLINT
+    } else {
+      return _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));// NOLINT
+    }
+  }
+
+  // The oldest taps are multiplied 4 at a time with 32x32->64 bit products; the newest 4 to 7 taps stay scalar so
+  // the vector loads never touch a sample stored in the last few iterations. Needs every sample to fit in 32 bits.
+  // int32_t samples take 8 taps per load: the even samples are already in the low halves of the 64-bit lanes and
+  // a shift brings down the odd ones, which saves a widening shuffle per 4 taps.
+  template<size_t Order, typename Sample>
+  __attribute__((target("avx2"))) void restore_avx2(Sample *data, size_t len, const int64_t *coefs, int shift)
+  {
+    constexpr size_t NUM_SCALAR = 4 + Order % 4;
+    constexpr size_t NUM_WIDE = sizeof(Sample) == 4 ? (Order - NUM_SCALAR) / 8 : 0;
+    constexpr size_t NUM_NARROW = (Order - NUM_SCALAR - 8 * NUM_WIDE) / 4;
+    constexpr size_t WIDE_START = NUM_SCALAR + 4 * NUM_NARROW;
+
+    __m256i narrow_coef[NUM_NARROW + 1];// NOLINT
+    for (size_t k = 0; k < NUM_NARROW; ++k) {
+      const int64_t *tap = coefs + NUM_SCALAR + 4 * k;
+      narrow_coef[k] = _mm256_set_epi64x(tap[0], tap[1], tap[2], tap[3]);
+    }
+    __m256i even_coef[NUM_WIDE + 1];// NOLINT
+    __m256i odd_coef[NUM_WIDE + 1];// NOLINT
+    for (size_t k = 0; k < NUM_WIDE; ++k) {
+      const int64_t *tap = coefs + WIDE_START + 8 * k;
+      even_coef[k] = _mm256_set_epi64x(tap[1], tap[3], tap[5], tap[7]);
+      odd_coef[k] = _mm256_set_epi64x(tap[0], tap[2], tap[4], tap[6]);
+    }
+    std::array<int64_t, NUM_SCALAR> coef{};
+    for (size_t j = 0; j < NUM_SCALAR; ++j) { coef[j] = coefs[j]; }
+    int64_t x1 = data[Order - 1];
+    int64_t x2 = data[Order - 2];
+    int64_t x3 = data[Order - 3];
+    int64_t x4 = data[Order - 4];
+
+    for (size_t i = Order; i < len; ++i) {
+      __m256i acc = _mm256_setzero_si256();
+      for (size_t k = 0; k < NUM_NARROW; ++k) {
+        auto samples = load_samples(data + i - NUM_SCALAR - 4 * k - 4);
+        acc = _mm256_add_epi64(acc, _mm256_mul_epi32(samples, narrow_coef[k]));
+      }
+      for (size_t k = 0; k < NUM_WIDE; ++k) {
+        const Sample *src = data + i - WIDE_START - 8 * k - 8;
+        auto samples = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));// NOLINT
+        acc = _mm256_add_epi64(acc, _mm256_mul_epi32(samples, even_coef[k]));
+        acc = _mm256_add_epi64(acc, _mm256_mul_epi32(_mm256_srli_epi64(samples, 32), odd_coef[k]));
+      }
+      auto half = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+      auto sum = static_cast<uint64_t>(_mm_cvtsi128_si64(half)) + static_cast<uint64_t>(_mm_extract_epi64(half, 1));
+      for (size_t j = 4; j < NUM_SCALAR; ++j) { sum += static_cast<uint64_t>(coef[j] * data[i - 1 - j]); }
+      sum += static_cast<uint64_t>(coef[0] * x1 + coef[1] * x2 + coef[2] * x3 + coef[3] * x4);
+      auto value = add_prediction(data[i], sum, shift);
+      data[i] = static_cast<Sample>(value);
+      x4 = x3;
+      x3 = x2;
+      x2 = x1;
+      x1 = static_cast<int64_t>(value);
+    }
+  }
+
+  template<typename Sample, size_t... Orders>
+  consteval std::array<Kernel<Sample>, sizeof...(Orders)> make_avx2_kernels(std::index_sequence<Orders...> /*orders*/)
+  {
+    return { &restore_avx2<Orders + AVX2_MIN_ORDER, Sample>... };
+  }
+
+  template<typename Sample>
+  constexpr auto AVX2_KERNELS = make_avx2_kernels<Sample>(std::make_index_sequence<NUM_KERNELS - AVX2_MIN_ORDER>());
+
+  bool has_avx2()
+  {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+  }
+#else
+  bool has_avx2() { return false; }
+#endif
+
+  template<typename Sample>
+  void restore_samples(std::span<Sample> data,
+    std::span<const int64_t> coefs,
+    int shift,
+    uint32_t bit_depth,
+    [[maybe_unused]] LpcKernels::Engine engine)
+  {
+    auto order = coefs.size();
+    if (order > LpcKernels::MAX_ORDER) { throw std::invalid_argument("LPC order is invalid"); }
+    if (bit_depth < 1 || bit_depth > 33) { throw std::invalid_argument("bit_depth is invalid"); }
+    if (shift < 0 || shift > 63) { throw std::invalid_argument("shift is invalid"); }
+    if (data.size() <= order) { return; }
+
+    // |sum| <= sum(|coef|) * 2^(bit_depth - 1), which decides whether a 32-bit accumulator is exact
+    uint64_t coef_magnitude = 0;
+    for (auto coef : coefs) { coef_magnitude += static_cast<uint64_t>(coef < 0 ? -coef : coef); }
+    const bool fits_32bit = (coef_magnitude << (bit_depth - 1U)) <= uint64_t{ INT32_MAX };
+
+#ifdef FLAC_CODEC_HAS_AVX2
+    if (engine == LpcKernels::Engine::Avx2 && order >= AVX2_MIN_ORDER && bit_depth <= 32 && has_avx2()) {
+      AVX2_KERNELS<Sample>.at(order - AVX2_MIN_ORDER)(data.data(), data.size(), coefs.data(), shift);
+      return;
+    }
+#endif
+
+    const auto &kernels = fits_32bit ? SCALAR_KERNELS<uint32_t, Sample> : SCALAR_KERNELS<uint64_t, Sample>;
+    kernels.at(order)(data.data(), data.size(), coefs.data(), shift);
+  }
+
+  template<typename Sample> void restore_fixed_samples(std::span<Sample> data, size_t order)
+  {
+    if (order > LpcKernels::MAX_FIXED_ORDER) { throw std::invalid_argument("Fixed prediction order is invalid"); }
+    if (data.size() <= order) { return; }
+
+    switch (order) {
+    case 1:
+      restore_fixed_order<1>(data.data(), data.size());
+      break;
+    case 2:
+      restore_fixed_order<2>(data.data(), data.size());
+      break;
+    case 3:
+      restore_fixed_order<3>(data.data(), data.size());
+      break;
+    case 4:
+      restore_fixed_order<4>(data.data(), data.size());
+      break;
+    default:
+      // Order 0 codes the samples themselves
+      break;
+    }
+  }
+
+}// namespace
+
+void LpcKernels::restore(std::span<int64_t> data, std::span<const int64_t> coefs, int shift, uint32_t bit_depth)
+{
+  static const Engine engine = get_engine();
+  restore_samples(data, coefs, shift, bit_depth, engine);
+}
+
+void LpcKernels::restore(std::span<int32_t> data, std::span<const int64_t> coefs, int shift, uint32_t bit_depth)
+{
+  static const Engine engine = get_engine();
+  restore_samples(data, coefs, shift, bit_depth, engine);
+}
+
+void LpcKernels::restore(std::span<int64_t> data,
+  std::span<const int64_t> coefs,
+  int shift,
+  uint32_t bit_depth,
+  Engine engine)
+{
+  restore_samples(data, coefs, shift, bit_depth, engine);
+}
+
+void LpcKernels::restore(std::span<int32_t> data,
+  std::span<const int64_t> coefs,
+  int shift,
+  uint32_t bit_depth,
+  Engine engine)
+{
+  restore_samples(data, coefs, shift, bit_depth, engine);
+}
+
+void LpcKernels::restore_fixed(std::span<int64_t> data, size_t order) { restore_fixed_samples(data, order); }
+
+void LpcKernels::restore_fixed(std::span<int32_t> data, size_t order) { restore_fixed_samples(data, order); }
+
+LpcKernels::Engine LpcKernels::get_engine() { return has_avx2() ? Engine::Avx2 : Engine::Scalar; }
+
+}// namespace flac
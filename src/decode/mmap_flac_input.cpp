@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <flac_codec/decode/flac_low_level_input.h>
+#include <flac_codec/decode/mmap_flac_input.h>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace flac {
+
+MmapFlacInput::MmapFlacInput(const std::string &filename, AccessPattern pattern)
+  : m_fd(::open(filename.c_str(), O_RDONLY | O_CLOEXEC)),// NOLINT
+    m_data(nullptr), m_length(0), m_offset(0)
+{
+  if (m_fd < 0) {
+    const std::string msg{ "Failed to open " + filename + ": " + std::strerror(errno) };
+    throw std::runtime_error(msg);
+  }
+
+  struct stat status{};
+  if (::fstat(m_fd, &status) != 0) {
+    const std::string msg{ "Failed to stat " + filename + ": " + std::strerror(errno) };
+    ::close(m_fd);
+    throw std::runtime_error(msg);
+  }
+  m_length = static_cast<size_t>(status.st_size);
+
+  // A zero-length mapping is invalid, an empty file simply reads as EOF
+  if (m_length > 0) {
+    void *addr = ::mmap(nullptr, m_length, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (addr == MAP_FAILED) {// NOLINT
+      const std::string msg{ "Failed to map " + filename + ": " + std::strerror(errno) };
+      ::close(m_fd);
+      throw std::runtime_error(msg);
+    }
+    m_data = static_cast<const uint8_t *>(addr);
+    advise(pattern);
+  }
+}
+
+MmapFlacInput::~MmapFlacInput() { close(); }
+
+size_t MmapFlacInput::get_length() const { return m_length; }
+
+void MmapFlacInput::seek_to(size_t pos)
+{
+  m_offset = std::min(pos, m_length);
+  position_changed(pos);
+}
+
+std::span<const uint8_t> MmapFlacInput::get_data() const { return { m_data, m_length }; }
+
+void MmapFlacInput::advise(AccessPattern pattern)
+{
+  if (m_data == nullptr) { return; }
+
+  // Hints only, a kernel that ignores them still decodes correctly
+  auto *addr = const_cast<uint8_t *>(m_data);// NOLINT
+  if (pattern == AccessPattern::Sequential) {
+    ::madvise(addr, m_length, MADV_SEQUENTIAL);
+    ::madvise(addr, m_length, MADV_WILLNEED);
+  } else {
+    ::madvise(addr, m_length, MADV_RANDOM);
+  }
+}
+
+std::optional<uint64_t> MmapFlacInput::read_underlying(std::vector<uint8_t> &buf, size_t off, size_t len)
+{
+  if (off > buf.size() || len > buf.size() - off) {
+    const std::string msg{ "off= " + std::to_string(off) + ", buf.size()= " + std::to_string(buf.size())
+                           + ", len= " + std::to_string(len)
+                           + ", offset is greater than buf.size() OR len is greater than buf.size() - offset (array index is out of bounds)" };
+    throw std::invalid_argument(msg);
+  }
+
+  auto min = std::min(m_length - m_offset, len);
+  if (min == 0) { return std::nullopt; }
+
+  std::memcpy(buf.data() + off, m_data + m_offset, min);
+  m_offset += min;
+  return min;
+}
+
+std::span<const uint8_t> MmapFlacInput::read_underlying_window()
+{
+  // The rest of the mapping is handed over in one piece, so the bit reader never refills again until the next seek
+  std::span<const uint8_t> window{ m_data + m_offset, m_length - m_offset };
+  m_offset = m_length;
+  return window;
+}
+
+void MmapFlacInput::close()
+{
+  if (m_fd >= 0) {
+    if (m_data != nullptr) { ::munmap(const_cast<uint8_t *>(m_data), m_length); }// NOLINT
+    ::close(m_fd);
+    m_fd = -1;
+    m_data = nullptr;
+    m_length = 0;
+    m_offset = 0;
+    FlacLowLevelInput::close();
+  }
+}
+}// namespace flac
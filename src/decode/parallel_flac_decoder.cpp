@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <flac_codec/common/stream_info.h>
+#include <flac_codec/decode/data_format_exception.h>
+#include <flac_codec/decode/flac_decoder.h>
+#include <flac_codec/decode/frame_decoder.h>
+#include <flac_codec/decode/frame_scanner.h>
+#include <flac_codec/decode/mmap_flac_input.h>
+#include <flac_codec/decode/parallel_flac_decoder.h>
+#include <flac_codec/decode/pcm_kernels.h>
+#include <flac_codec/decode/sample_buffer.h>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flac {
+
+namespace {
+
+  size_t get_frame_capacity(const SampleBuffer &out) { return out.frame_capacity; }
+
+  size_t get_frame_capacity(const PcmBuffer &out) { return out.get_frame_capacity(); }
+
+  // Same sample type choice as FlacDecoder
+  template<ValidationLevel Level>
+  std::unique_ptr<IFrameDecoder> make_frame_decoder(MmapFlacInput &input, uint32_t bit_depth)
+  {
+    if (bit_depth <= 31) { return std::make_unique<FrameDecoder<MmapFlacInput, Level, int32_t>>(input, bit_depth); }
+    return std::make_unique<FrameDecoder<MmapFlacInput, Level, int64_t>>(input, bit_depth);
+  }
+
+  std::unique_ptr<IFrameDecoder> make_frame_decoder(MmapFlacInput &input, ValidationLevel level, uint32_t bit_depth)
+  {
+    if (level == ValidationLevel::Trusted) { return make_frame_decoder<ValidationLevel::Trusted>(input, bit_depth); }
+    if (level == ValidationLevel::Checked) { return make_frame_decoder<ValidationLevel::Checked>(input, bit_depth); }
+    return make_frame_decoder<ValidationLevel::Strict>(input, bit_depth);
+  }
+
+}// namespace
+
+ParallelFlacDecoder::ParallelFlacDecoder(const std::string &file_name, ValidationLevel validation, unsigned num_threads)
+  : m_file_name(file_name), m_validation(validation),
+    m_num_threads(num_threads == 0 ? std::max(1U, std::thread::hardware_concurrency()) : num_threads)
+{
+  FlacDecoder dec(file_name, FlacDecoder::InputType::Mmap, validation);
+  while (dec.read_and_handle_metadata_block().has_value()) {}
+  if (dec.m_stream_info == nullptr) { throw DataFormatException("Expected stream info metadata block"); }
+
+  m_stream_info = *dec.m_stream_info;
+  m_frames = FrameScanner::scan(file_name, dec.get_metadata_end_pos().value_or(0), m_num_threads);
+}
+
+const StreamInfo &ParallelFlacDecoder::get_stream_info() const { return m_stream_info; }
+
+const std::vector<FrameLocation> &ParallelFlacDecoder::get_frames() const { return m_frames; }
+
+uint64_t ParallelFlacDecoder::get_num_samples() const
+{
+  if (m_frames.empty()) { return 0; }
+  return m_frames.back().m_sample_offset + m_frames.back().m_block_size;
+}
+
+void ParallelFlacDecoder::decode(const SampleBuffer &out, size_t first_frame, size_t num_frames)
+{
+  decode_into(out, first_frame, num_frames);
+}
+
+void ParallelFlacDecoder::decode(const PcmBuffer &out, size_t first_frame, size_t num_frames)
+{
+  decode_into(out, first_frame, num_frames);
+}
+
+void ParallelFlacDecoder::visit(const FrameVisitor &visit, size_t step, size_t first_frame, size_t num_frames)
+{
+  if (step == 0) { throw std::invalid_argument("Frame step must be positive"); }
+  if (first_frame > m_frames.size()) { throw std::invalid_argument("First frame is out of bounds"); }
+  auto end_frame = first_frame + std::min(num_frames, m_frames.size() - first_frame);
+
+  if (first_frame == end_frame) { return; }
+
+  run_batches(first_frame, end_frame, FRAMES_PER_BATCH * step, step, 0, [&] {
+    // One block per thread for every frame it decodes; moving the vector into the worker keeps its storage in place
+    std::vector<int32_t> samples;
+    auto block = make_block(samples);
+    return [this, &visit, samples = std::move(samples), block](IFrameDecoder &decoder, size_t /*batch*/, size_t idx) {
+      check_frame(decoder.read_frame(block, 0), idx);
+      visit(m_frames[idx], block);
+    };
+  });
+}
+
+void ParallelFlacDecoder::visit_ranges(size_t frames_per_range, size_t lead_in_frames, const RangeVisitor &visit)
+{
+  if (frames_per_range == 0) { throw std::invalid_argument("Range size must be positive"); }
+  if (m_frames.empty()) { return; }
+
+  // A batch is a range, so a single thread goes through it in order
+  run_batches(0, m_frames.size(), frames_per_range, 1, lead_in_frames, [&] {
+    std::vector<int32_t> samples;
+    auto block = make_block(samples);
+    return [this, &visit, frames_per_range, samples = std::move(samples), block](
+             IFrameDecoder &decoder, size_t range, size_t idx) {
+      check_frame(decoder.read_frame(block, 0), idx);
+      visit(range, m_frames[idx], block, idx < range * frames_per_range);
+    };
+  });
+}
+
+template<typename Output>
+void ParallelFlacDecoder::decode_into(const Output &out, size_t first_frame, size_t num_frames)
+{
+  if (first_frame > m_frames.size()) { throw std::invalid_argument("First frame is out of bounds"); }
+  auto end_frame = first_frame + std::min(num_frames, m_frames.size() - first_frame);
+  if (first_frame == end_frame) { return; }
+
+  auto base = m_frames[first_frame].m_sample_offset;
+  const FrameLocation &last = m_frames[end_frame - 1];
+  if (last.m_sample_offset + last.m_block_size - base > get_frame_capacity(out)) {
+    throw std::invalid_argument("Output buffer too small for the frame range");
+  }
+
+  run_batches(first_frame, end_frame, FRAMES_PER_BATCH, 1, 0, [&] {
+    return [this, &out, base](IFrameDecoder &decoder, size_t /*batch*/, size_t idx) {
+      check_frame(decoder.read_frame(out, m_frames[idx].m_sample_offset - base), idx);
+    };
+  });
+}
+
+template<typename MakeWorker>
+void ParallelFlacDecoder::run_batches(size_t first_frame,
+  size_t end_frame,
+  size_t batch_span,
+  size_t step,
+  size_t lead_in,
+  const MakeWorker &make_worker)
+{
+  auto num_batches = (end_frame - first_frame + batch_span - 1) / batch_span;
+  auto num_workers = std::min<size_t>(m_num_threads, num_batches);
+  std::atomic<size_t> next_batch{ 0 };
+  std::atomic<bool> failed{ false };
+  std::vector<std::exception_ptr> errors(num_workers);
+
+  auto work = [&](size_t worker) {
+    try {
+      MmapFlacInput input(m_file_name);
+      auto decoder = make_frame_decoder(input, m_validation, m_stream_info.m_bit_depth);
+      auto process = make_worker();
+
+      while (!failed.load(std::memory_order_relaxed)) {
+        auto batch = next_batch.fetch_add(1, std::memory_order_relaxed);
+        auto batch_start = first_frame + batch * batch_span;
+        if (batch_start >= end_frame) { break; }
+        auto batch_end = std::min(batch_start + batch_span, end_frame);
+        auto start = batch_start - std::min(lead_in, batch_start - first_frame);
+
+        // Consecutive frames are contiguous, so with a step of 1 only the first one of a batch needs a seek
+        for (size_t idx = start; idx < batch_end; idx += step) {
+          if (idx == start || step != 1) { input.seek_to(m_frames[idx].m_file_offset); }
+          process(*decoder, batch, idx);
+        }
+      }
+    } catch (...) {
+      errors[worker] = std::current_exception();
+      failed = true;
+    }
+  };
+
+  {
+    std::vector<std::jthread> workers;
+    for (size_t worker = 1; worker < num_workers; ++worker) { workers.emplace_back(work, worker); }
+    work(0);
+  }
+
+  for (const auto &error : errors) {
+    if (error) { std::rethrow_exception(error); }
+  }
+}
+
+SampleBuffer ParallelFlacDecoder::make_block(std::vector<int32_t> &storage) const
+{
+  const uint32_t num_channels = m_stream_info.m_num_channels;
+  const size_t block_size = m_stream_info.m_max_block_size;
+  storage.assign(num_channels * block_size, 0);
+  std::array<std::span<int32_t>, SampleBuffer::MAX_CHANNELS> channels{};
+  for (size_t ch = 0; ch < num_channels; ++ch) { channels.at(ch) = { storage.data() + ch * block_size, block_size }; }
+  return SampleBuffer::planar({ channels.data(), num_channels });
+}
+
+void ParallelFlacDecoder::check_frame(const std::optional<FrameInfo> &frame, size_t idx) const
+{
+  // A sync pattern the scanner mistook for a header would show up as a frame of the wrong size
+  const FrameLocation &loc = m_frames[idx];
+  const bool has_next = idx + 1 < m_frames.size();
+  if (!frame.has_value() || frame->m_block_size.value_or(0) != loc.m_block_size
+      || (has_next && loc.m_file_offset + frame->m_frame_size.value_or(0) != m_frames[idx + 1].m_file_offset)) {
+    throw DataFormatException("Frame boundary mismatch");
+  }
+}
+
+}// namespace flac
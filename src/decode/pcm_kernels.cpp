@@ -0,0 +1,356 @@
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/decode/pcm_kernels.h>
+#include <span>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FLAC_CODEC_HAS_AVX2 1
+#endif
+
+namespace flac {
+
+namespace {
+
+  using Encoding = PcmKernels::Encoding;
+
+  constexpr size_t get_size(Encoding encoding)
+  {
+    switch (encoding) {
+    case Encoding::S16:
+      return 2;
+    case Encoding::S24:
+      return 3;
+    case Encoding::S32:
+    case Encoding::F32:
+      return 4;
+    default:
+      throw std::invalid_argument("PCM encoding is invalid");
+    }
+  }
+
+  // Shifts that move a bit_depth-bit sample to the width of the encoding; at most one of them is non-zero
+  struct Scaling
+  {
+    int left;
+    int right;
+    float scale;
+  };
+
+  Scaling get_scaling(Encoding encoding, uint32_t bit_depth)
+  {
+    if (bit_depth < 1 || bit_depth > 32) { throw std::invalid_argument("bit_depth is invalid"); }
+    if (encoding == Encoding::F32) { return { 0, 0, std::ldexp(1.0F, 1 - static_cast<int>(bit_depth)) }; }
+
+    auto width = static_cast<int>(get_size(encoding) * 8);
+    auto diff = width - static_cast<int>(bit_depth);
+    return { diff > 0 ? diff : 0, diff < 0 ? -diff : 0, 1.0F };
+  }
+
+  template<size_t Size> inline void put_le(std::byte *dst, uint32_t val)
+  {
+    for (size_t i = 0; i < Size; ++i) { dst[i] = static_cast<std::byte>(val >> (8 * i)); }
+  }
+
+  template<Encoding Enc, typename Sample> inline void put_sample(std::byte *dst, Sample sample, Scaling scaling)
+  {
+    if constexpr (Enc == Encoding::F32) {
+      put_le<4>(dst, std::bit_cast<uint32_t>(static_cast<float>(sample) * scaling.scale));
+    } else {
+      auto val = static_cast<int64_t>(static_cast<uint64_t>(sample) << scaling.left) >> scaling.right;// NOLINT
+      put_le<get_size(Enc)>(dst, static_cast<uint32_t>(val));
+    }
+  }
+
+  template<Encoding Enc, typename Sample>
+  void store_channel_scalar(const Sample *src, std::byte *dst, size_t len, size_t stride, Scaling scaling)
+  {
+    for (size_t i = 0; i < len; ++i) { put_sample<Enc>(dst + i * stride, src[i], scaling); }
+  }
+
+  template<Encoding Enc, typename Sample>
+  void store_stereo_scalar(const Sample *left, const Sample *right, std::byte *dst, size_t len, Scaling scaling)
+  {
+    constexpr size_t SIZE = get_size(Enc);
+    for (size_t i = 0; i < len; ++i) {
+      put_sample<Enc>(dst + 2 * i * SIZE, left[i], scaling);
+      put_sample<Enc>(dst + (2 * i + 1) * SIZE, right[i], scaling);
+    }
+  }
+
+#ifdef FLAC_CODEC_HAS_AVX2
+  __attribute__((target("avx2"))) inline __m256i load8(const int32_t *src)
+  {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));// NOLINT
+  }
+
+  __attribute__((target("avx2"))) inline void store32(std::byte *dst, __m256i val)
+  {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), val);// NOLINT
+  }
+
+  template<Encoding Enc> __attribute__((target("avx2"))) inline __m256i scale8(__m256i val, Scaling scaling)
+  {
+    if constexpr (Enc == Encoding::F32) {
+      return _mm256_castps_si256(_mm256_mul_ps(_mm256_cvtepi32_ps(val), _mm256_set1_ps(scaling.scale)));
+    } else {
+      val = _mm256_sll_epi32(val, _mm_cvtsi32_si128(scaling.left));
+      return _mm256_sra_epi32(val, _mm_cvtsi32_si128(scaling.right));
+    }
+  }
+
+  // Drops the top byte of each 32-bit lane, leaving 12 packed bytes at the bottom of each 128-bit half
+  __attribute__((target("avx2"))) inline __m256i pack24(__m256i val)
+  {
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,// NOLINT
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    return _mm256_shuffle_epi8(val, shuffle);
+  }
+
+  // Each half is written with a 16-byte store of which only 12 bytes are kept, so the caller leaves 4 bytes of slack
+  __attribute__((target("avx2"))) inline void store24(std::byte *dst, __m256i val)
+  {
+    auto packed = pack24(val);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm256_castsi256_si128(packed));// NOLINT
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 12), _mm256_extracti128_si256(packed, 1));// NOLINT
+  }
+
+  template<Encoding Enc>
+  __attribute__((target("avx2"))) void
+    store_planar_avx2(const int32_t *src, std::byte *dst, size_t len, Scaling scaling)
+  {
+    constexpr size_t SIZE = get_size(Enc);
+    size_t i = 0;
+    if constexpr (Enc == Encoding::S16) {
+      for (; i + 16 <= len; i += 16) {
+        // The values already fit in 16 bits, so the saturating pack is exact; it works per 128-bit half
+        auto low = scale8<Enc>(load8(src + i), scaling);
+        auto high = scale8<Enc>(load8(src + i + 8), scaling);
+        store32(dst + 2 * i, _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8));
+      }
+    } else if constexpr (Enc == Encoding::S24) {
+      for (; i + 10 <= len; i += 8) { store24(dst + 3 * i, scale8<Enc>(load8(src + i), scaling)); }
+    } else {
+      for (; i + 8 <= len; i += 8) { store32(dst + 4 * i, scale8<Enc>(load8(src + i), scaling)); }
+    }
+    store_channel_scalar<Enc>(src + i, dst + i * SIZE, len - i, SIZE, scaling);
+  }
+
+  template<Encoding Enc>
+  __attribute__((target("avx2"))) void
+    store_stereo_avx2(const int32_t *left, const int32_t *right, std::byte *dst, size_t len, Scaling scaling)
+  {
+    constexpr size_t SIZE = get_size(Enc);
+    size_t i = 0;
+    if constexpr (Enc == Encoding::S16) {
+      // Both 16-bit samples of a frame fit in one 32-bit lane
+      const __m256i low_mask = _mm256_set1_epi32(0xFFFF);
+      for (; i + 8 <= len; i += 8) {
+        auto l = scale8<Enc>(load8(left + i), scaling);
+        auto r = scale8<Enc>(load8(right + i), scaling);
+        store32(dst + 4 * i, _mm256_or_si256(_mm256_and_si256(l, low_mask), _mm256_slli_epi32(r, 16)));
+      }
+    } else {
+      // The unpacks interleave within 128-bit halves, the permutes put the halves back in order
+      for (; i + 8 + (Enc == Encoding::S24 ? 1 : 0) <= len; i += 8) {
+        auto l = scale8<Enc>(load8(left + i), scaling);
+        auto r = scale8<Enc>(load8(right + i), scaling);
+        auto lo = _mm256_unpacklo_epi32(l, r);
+        auto hi = _mm256_unpackhi_epi32(l, r);
+        auto first = _mm256_permute2x128_si256(lo, hi, 0x20);
+        auto second = _mm256_permute2x128_si256(lo, hi, 0x31);
+        if constexpr (Enc == Encoding::S24) {
+          store24(dst + 2 * SIZE * i, first);
+          store24(dst + 2 * SIZE * i + 24, second);
+        } else {
+          store32(dst + 2 * SIZE * i, first);
+          store32(dst + 2 * SIZE * i + 32, second);
+        }
+      }
+    }
+    store_stereo_scalar<Enc>(left + i, right + i, dst + 2 * SIZE * i, len - i, scaling);
+  }
+
+  bool has_avx2()
+  {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+  }
+#else
+  bool has_avx2() { return false; }
+#endif
+
+  template<Encoding Enc, typename Sample>
+  void store_channel_with([[maybe_unused]] PcmKernels::Engine engine,
+    const Sample *src,
+    std::byte *dst,
+    size_t len,
+    size_t stride,
+    Scaling scaling)
+  {
+#ifdef FLAC_CODEC_HAS_AVX2
+    if constexpr (sizeof(Sample) == 4) {
+      if (engine == PcmKernels::Engine::Avx2 && stride == get_size(Enc) && has_avx2()) {
+        store_planar_avx2<Enc>(src, dst, len, scaling);
+        return;
+      }
+    }
+#endif
+    store_channel_scalar<Enc>(src, dst, len, stride, scaling);
+  }
+
+  template<Encoding Enc, typename Sample>
+  void store_stereo_with([[maybe_unused]] PcmKernels::Engine engine,
+    const Sample *left,
+    const Sample *right,
+    std::byte *dst,
+    size_t len,
+    Scaling scaling)
+  {
+#ifdef FLAC_CODEC_HAS_AVX2
+    if constexpr (sizeof(Sample) == 4) {
+      if (engine == PcmKernels::Engine::Avx2 && has_avx2()) {
+        store_stereo_avx2<Enc>(left, right, dst, len, scaling);
+        return;
+      }
+    }
+#endif
+    store_stereo_scalar<Enc>(left, right, dst, len, scaling);
+  }
+
+  template<typename Sample>
+  void store_channel_samples(std::span<const Sample> src,
+    std::span<std::byte> dst,
+    size_t stride,
+    Encoding encoding,
+    uint32_t bit_depth,
+    PcmKernels::Engine engine)
+  {
+    auto size = get_size(encoding);
+    if (stride < size) { throw std::invalid_argument("stride is invalid"); }
+    if (!src.empty() && dst.size() < (src.size() - 1) * stride + size) {
+      throw std::invalid_argument("PCM buffer is too small");
+    }
+    auto scaling = get_scaling(encoding, bit_depth);
+
+    switch (encoding) {
+    case Encoding::S16:
+      store_channel_with<Encoding::S16>(engine, src.data(), dst.data(), src.size(), stride, scaling);
+      break;
+    case Encoding::S24:
+      store_channel_with<Encoding::S24>(engine, src.data(), dst.data(), src.size(), stride, scaling);
+      break;
+    case Encoding::S32:
+      store_channel_with<Encoding::S32>(engine, src.data(), dst.data(), src.size(), stride, scaling);
+      break;
+    case Encoding::F32:
+      store_channel_with<Encoding::F32>(engine, src.data(), dst.data(), src.size(), stride, scaling);
+      break;
+    }
+  }
+
+  template<typename Sample>
+  void store_stereo_samples(std::span<const Sample> left,
+    std::span<const Sample> right,
+    std::span<std::byte> dst,
+    Encoding encoding,
+    uint32_t bit_depth,
+    PcmKernels::Engine engine)
+  {
+    auto len = left.size();
+    if (right.size() < len) { throw std::invalid_argument("Channel buffers are too small"); }
+    if (dst.size() < 2 * len * get_size(encoding)) {
+      throw std::invalid_argument("PCM buffer is too small");
+    }
+    auto scaling = get_scaling(encoding, bit_depth);
+
+    switch (encoding) {
+    case Encoding::S16:
+      store_stereo_with<Encoding::S16>(engine, left.data(), right.data(), dst.data(), len, scaling);
+      break;
+    case Encoding::S24:
+      store_stereo_with<Encoding::S24>(engine, left.data(), right.data(), dst.data(), len, scaling);
+      break;
+    case Encoding::S32:
+      store_stereo_with<Encoding::S32>(engine, left.data(), right.data(), dst.data(), len, scaling);
+      break;
+    case Encoding::F32:
+      store_stereo_with<Encoding::F32>(engine, left.data(), right.data(), dst.data(), len, scaling);
+      break;
+    }
+  }
+
+}// namespace
+
+size_t PcmKernels::get_sample_size(Encoding encoding) { return get_size(encoding); }
+
+void PcmKernels::store_channel(std::span<const int32_t> src,
+  std::span<std::byte> dst,
+  size_t stride,
+  Encoding encoding,
+  uint32_t bit_depth)
+{
+  static const Engine engine = get_engine();
+  store_channel_samples(src, dst, stride, encoding, bit_depth, engine);
+}
+
+void PcmKernels::store_channel(std::span<const int64_t> src,
+  std::span<std::byte> dst,
+  size_t stride,
+  Encoding encoding,
+  uint32_t bit_depth)
+{
+  store_channel_samples(src, dst, stride, encoding, bit_depth, Engine::Scalar);
+}
+
+void PcmKernels::store_stereo(std::span<const int32_t> left,
+  std::span<const int32_t> right,
+  std::span<std::byte> dst,
+  Encoding encoding,
+  uint32_t bit_depth)
+{
+  static const Engine engine = get_engine();
+  store_stereo_samples(left, right, dst, encoding, bit_depth, engine);
+}
+
+void PcmKernels::store_stereo(std::span<const int64_t> left,
+  std::span<const int64_t> right,
+  std::span<std::byte> dst,
+  Encoding encoding,
+  uint32_t bit_depth)
+{
+  store_stereo_samples(left, right, dst, encoding, bit_depth, Engine::Scalar);
+}
+
+void PcmKernels::store_channel(std::span<const int32_t> src,
+  std::span<std::byte> dst,
+  size_t stride,
+  Encoding encoding,
+  uint32_t bit_depth,
+  Engine engine)
+{
+  store_channel_samples(src, dst, stride, encoding, bit_depth, engine);
+}
+
+void PcmKernels::store_stereo(std::span<const int32_t> left,
+  std::span<const int32_t> right,
+  std::span<std::byte> dst,
+  Encoding encoding,
+  uint32_t bit_depth,
+  Engine engine)
+{
+  store_stereo_samples(left, right, dst, encoding, bit_depth, engine);
+}
+
+PcmKernels::Engine PcmKernels::get_engine() { return has_avx2() ? Engine::Avx2 : Engine::Scalar; }
+
+size_t PcmBuffer::get_frame_capacity() const
+{
+  if (num_channels == 0) { throw std::invalid_argument("Number of channels is invalid"); }
+  return data.size() / (size_t(num_channels) * get_size(encoding));
+}
+
+}// namespace flac
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/decode/frame_decoder.h>
+#include <flac_codec/decode/frame_scanner.h>
+#include <flac_codec/decode/parallel_flac_decoder.h>
+#include <flac_codec/decode/peak_generator.h>
+#include <flac_codec/decode/sample_buffer.h>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace flac {
+
+namespace {
+
+  const std::array<uint8_t, 8> MAGIC{ 'F', 'L', 'A', 'C', 'P', 'K', 'S', 1 };
+
+  struct Accumulator
+  {
+    int32_t m_min = std::numeric_limits<int32_t>::max();
+    int32_t m_max = std::numeric_limits<int32_t>::min();
+    double m_sum_of_squares = 0;
+    uint64_t m_count = 0;
+  };
+
+  void merge(Accumulator &into, const Accumulator &from)
+  {
+    into.m_min = std::min(into.m_min, from.m_min);
+    into.m_max = std::max(into.m_max, from.m_max);
+    into.m_sum_of_squares += from.m_sum_of_squares;
+    into.m_count += from.m_count;
+  }
+
+  // One pass the compiler can vectorize. A frame holds at most 65535 samples, whose squares sum exactly in 64 bits up
+  // to 24-bit samples; wider ones are summed as double.
+  template<typename Sum> Accumulator reduce(const int32_t *data, size_t len)
+  {
+    int32_t min = std::numeric_limits<int32_t>::max();
+    int32_t max = std::numeric_limits<int32_t>::min();
+    Sum sum = 0;
+    for (size_t i = 0; i < len; ++i) {
+      min = std::min(min, data[i]);
+      max = std::max(max, data[i]);
+      sum += static_cast<Sum>(int64_t{ data[i] } * data[i]);
+    }
+    return { min, max, static_cast<double>(sum), len };
+  }
+
+  void put_le(std::vector<uint8_t> &data, uint64_t val, size_t size)
+  {
+    for (size_t i = 0; i < size; ++i) { data.push_back(static_cast<uint8_t>(val >> (8 * i))); }
+  }
+
+}// namespace
+
+void PeakOverview::save(const std::string &file) const
+{
+  std::vector<uint8_t> data(MAGIC.begin(), MAGIC.end());
+  put_le(data, m_num_channels, 4);
+  put_le(data, m_bucket_size, 4);
+  put_le(data, m_num_samples, 8);
+  put_le(data, m_num_channels == 0 ? 0 : m_peaks.size() / m_num_channels, 8);
+  for (const Peak &peak : m_peaks) {
+    put_le(data, static_cast<uint32_t>(peak.m_min), 4);
+    put_le(data, static_cast<uint32_t>(peak.m_max), 4);
+    put_le(data, std::bit_cast<uint32_t>(peak.m_rms), 4);
+  }
+
+  std::ofstream out(file, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));// NOLINT
+  if (!out) { throw std::runtime_error("Failed to write " + file); }
+}
+
+PeakGenerator::PeakGenerator(const std::string &file_name, ValidationLevel validation, unsigned num_threads)
+  : m_decoder(file_name, validation, num_threads)
+{}
+
+PeakOverview PeakGenerator::generate(uint32_t bucket_size, unsigned frame_step)
+{
+  if (bucket_size == 0) { throw std::invalid_argument("Bucket size must be positive"); }
+
+  const StreamInfo &info = m_decoder.get_stream_info();
+  PeakOverview result{ info.m_num_channels, bucket_size, m_decoder.get_num_samples(), {} };
+  const size_t num_channels = result.m_num_channels;
+  auto num_buckets = (result.m_num_samples + bucket_size - 1) / bucket_size;
+  std::vector<Accumulator> buckets(num_buckets * num_channels);
+  std::mutex edge_mutex;
+  auto reduce_run = info.m_bit_depth <= 24 ? &reduce<uint64_t> : &reduce<double>;
+
+  m_decoder.visit(
+    [&](const FrameLocation &frame, const SampleBuffer &block) {
+      if (frame.m_block_size == 0) { return; }
+      auto frame_end = frame.m_sample_offset + frame.m_block_size;
+      auto first = frame.m_sample_offset / bucket_size;
+      auto last = (frame_end - 1) / bucket_size;
+
+      for (auto bucket = first; bucket <= last; ++bucket) {
+        auto begin = std::max(bucket * bucket_size, frame.m_sample_offset) - frame.m_sample_offset;
+        auto end = std::min((bucket + 1) * bucket_size, frame_end) - frame.m_sample_offset;
+        std::array<Accumulator, SampleBuffer::MAX_CHANNELS> runs{};
+        for (size_t ch = 0; ch < num_channels; ++ch) {
+          runs.at(ch) = reduce_run(block.channels.at(ch) + begin, end - begin);
+        }
+
+        // Buckets inside the frame are only ever touched by it, the ones at its edges may be shared with its neighbours
+        Accumulator *dst = buckets.data() + bucket * num_channels;
+        if (bucket == first || bucket == last) {
+          const std::lock_guard lock(edge_mutex);
+          for (size_t ch = 0; ch < num_channels; ++ch) { merge(dst[ch], runs.at(ch)); }
+        } else {
+          std::copy(runs.begin(), runs.begin() + long(num_channels), dst);
+        }
+      }
+    },
+    frame_step);
+
+  result.m_peaks.resize(buckets.size());
+  for (size_t idx = 0; idx < buckets.size(); ++idx) {
+    const Accumulator &acc = buckets[idx];
+    if (acc.m_count == 0) {
+      result.m_peaks[idx] = idx >= num_channels ? result.m_peaks[idx - num_channels] : Peak{ 0, 0, 0 };
+    } else {
+      auto rms = std::sqrt(acc.m_sum_of_squares / static_cast<double>(acc.m_count));
+      result.m_peaks[idx] = { acc.m_min, acc.m_max, static_cast<float>(rms) };
+    }
+  }
+  return result;
+}
+
+}// namespace flac
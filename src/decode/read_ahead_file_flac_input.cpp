@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <flac_codec/decode/flac_low_level_input.h>
+#include <flac_codec/decode/read_ahead_file_flac_input.h>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace flac {
+
+ReadAheadFileFlacInput::ReadAheadFileFlacInput(const std::string &filename, size_t chunk_size)
+  : m_fd(::open(filename.c_str(), O_RDONLY | O_CLOEXEC)),// NOLINT
+    m_file_length(0), m_front(0), m_chunk_size(std::max<size_t>(chunk_size, 4096)), m_fill_offset(0),
+    m_fill_result(0), m_fill_pending(false), m_fill_done(false), m_stop(false)
+{
+  if (m_fd < 0) {
+    const std::string msg{ "Failed to open " + filename + ": " + std::strerror(errno) };
+    throw std::runtime_error(msg);
+  }
+
+  struct stat status{};
+  if (::fstat(m_fd, &status) != 0) {
+    const std::string msg{ "Failed to stat " + filename + ": " + std::strerror(errno) };
+    ::close(m_fd);
+    throw std::runtime_error(msg);
+  }
+  m_file_length = static_cast<size_t>(status.st_size);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  m_worker = std::thread(&ReadAheadFileFlacInput::worker_loop, this);
+  request_fill(0);
+}
+
+ReadAheadFileFlacInput::~ReadAheadFileFlacInput() { close(); }
+
+size_t ReadAheadFileFlacInput::get_length() const { return m_file_length; }
+
+void ReadAheadFileFlacInput::seek_to(size_t pos)
+{
+  // A fill in flight targets the old position, let it land in the back buffer and start over
+  wait_fill();
+  position_changed(pos);
+  request_fill(pos);
+}
+
+void ReadAheadFileFlacInput::set_chunk_size(size_t chunk_size)
+{
+  const std::scoped_lock lock(m_mutex);
+  m_chunk_size = std::max<size_t>(chunk_size, 4096);
+}
+
+std::optional<uint64_t> ReadAheadFileFlacInput::read_underlying(std::vector<uint8_t> &buf, size_t off, size_t len)
+{
+  if (off > buf.size() || len > buf.size() - off) {
+    const std::string msg{ "off= " + std::to_string(off) + ", buf.size()= " + std::to_string(buf.size())
+                           + ", len= " + std::to_string(len)
+                           + ", offset is greater than buf.size() OR len is greater than buf.size() - offset (array index is out of bounds)" };
+    throw std::invalid_argument(msg);
+  }
+
+  // Copying path for callers that bypass the window, reads synchronously and moves the prefetch past the copied bytes
+  auto offset = wait_fill() == 0 ? m_file_length : m_fill_offset;
+  auto num_read = read_at(buf.data() + off, len, offset);
+  request_fill(offset + num_read);
+  if (num_read == 0) { return std::nullopt; }
+  return num_read;
+}
+
+std::span<const uint8_t> ReadAheadFileFlacInput::read_underlying_window()
+{
+  auto len = wait_fill();
+  if (len == 0) { return {}; }
+
+  // The freshly filled buffer is handed to the bit reader, the one it just released is refilled in the background
+  m_front ^= 1U;
+  request_fill(m_fill_offset + len);
+  return { m_buffers.at(m_front).data(), len };
+}
+
+void ReadAheadFileFlacInput::request_fill(size_t offset)
+{
+  {
+    const std::scoped_lock lock(m_mutex);
+    m_fill_offset = offset;
+    m_fill_done = false;
+    m_fill_pending = true;
+  }
+  m_cond.notify_all();
+}
+
+size_t ReadAheadFileFlacInput::wait_fill()
+{
+  std::unique_lock lock(m_mutex);
+  if (!m_fill_pending && !m_fill_done) { return 0; }
+  m_cond.wait(lock, [this] { return m_fill_done; });
+  m_fill_pending = false;
+  m_fill_done = false;
+  if (m_fill_error) { std::rethrow_exception(std::exchange(m_fill_error, nullptr)); }
+  return m_fill_result;
+}
+
+void ReadAheadFileFlacInput::worker_loop()
+{
+  while (true) {
+    size_t offset = 0;
+    size_t chunk_size = 0;
+    {
+      std::unique_lock lock(m_mutex);
+      m_cond.wait(lock, [this] { return m_stop || (m_fill_pending && !m_fill_done); });
+      if (m_stop) { return; }
+      offset = m_fill_offset;
+      chunk_size = m_chunk_size;
+    }
+
+    // The back buffer is not referenced by the bit reader, so it can be resized and written without the lock
+    auto &buf = m_buffers.at(m_front ^ 1U);
+    if (buf.size() != chunk_size) { buf.resize(chunk_size); }
+    size_t num_read = 0;
+    std::exception_ptr error;
+    try {
+      num_read = read_at(buf.data(), buf.size(), offset);
+    } catch (const std::runtime_error &) {
+      error = std::current_exception();
+    }
+
+    {
+      const std::scoped_lock lock(m_mutex);
+      m_fill_result = num_read;
+      m_fill_error = error;
+      m_fill_done = true;
+    }
+    m_cond.notify_all();
+  }
+}
+
+size_t ReadAheadFileFlacInput::read_at(uint8_t *dst, size_t len, size_t offset) const
+{
+  size_t total = 0;
+  while (total < len && offset + total < m_file_length) {
+    auto res = ::pread(m_fd, dst + total, len - total, static_cast<off_t>(offset + total));
+    if (res < 0) {
+      if (errno == EINTR) { continue; }
+      const std::string msg{ std::string("Read failed: ") + std::strerror(errno) };
+      throw std::runtime_error(msg);
+    }
+    if (res == 0) { break; }
+    total += static_cast<size_t>(res);
+  }
+  return total;
+}
+
+void ReadAheadFileFlacInput::close()
+{
+  if (m_worker.joinable()) {
+    {
+      const std::scoped_lock lock(m_mutex);
+      m_stop = true;
+    }
+    m_cond.notify_all();
+    m_worker.join();
+  }
+
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+    FlacLowLevelInput::close();
+  }
+}
+}// namespace flac
@@ -0,0 +1,41 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <flac_codec/decode/sample_buffer.h>
+#include <span>
+#include <stdexcept>
+
+namespace flac {
+
+SampleBuffer SampleBuffer::planar(std::span<const std::span<int32_t>> channels)
+{
+  if (channels.empty() || channels.size() > MAX_CHANNELS) {
+    throw std::invalid_argument("Number of channels is invalid");
+  }
+
+  SampleBuffer result{};
+  result.stride = 1;
+  result.frame_capacity = channels[0].size();
+  result.num_channels = static_cast<uint32_t>(channels.size());
+  for (size_t ch = 0; ch < channels.size(); ++ch) {
+    result.channels[ch] = channels[ch].data();
+    result.frame_capacity = std::min(result.frame_capacity, channels[ch].size());
+  }
+  return result;
+}
+
+SampleBuffer SampleBuffer::interleaved(std::span<int32_t> data, uint32_t num_channels)
+{
+  if (num_channels == 0 || num_channels > MAX_CHANNELS) {
+    throw std::invalid_argument("Number of channels is invalid");
+  }
+
+  SampleBuffer result{};
+  result.stride = num_channels;
+  result.frame_capacity = data.size() / num_channels;
+  result.num_channels = num_channels;
+  for (size_t ch = 0; ch < num_channels; ++ch) { result.channels[ch] = data.data() + ch; }
+  return result;
+}
+
+}// namespace flac
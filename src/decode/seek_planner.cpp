@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cstdint>
+#include <flac_codec/common/seek_table.h>
+#include <flac_codec/common/stream_info.h>
+#include <flac_codec/decode/seek_planner.h>
+#include <stdexcept>
+#include <utility>
+
+namespace flac {
+
+namespace {
+
+  // Fixed-point scale of the bytes per sample average
+  const uint64_t SCALE = 1U << 16U;
+
+}// namespace
+
+SeekPlanner::SeekPlanner(const StreamInfo &info, const SeekTable *table, uint64_t audio_start, uint64_t file_length)
+  : m_audio_start(audio_start), m_file_length(file_length), m_num_samples(info.m_num_samples),
+    m_block_size(info.m_max_block_size)
+{
+  if (table != nullptr) {
+    try {
+      table->check_values();
+      for (const SeekTable::SeekPoint &point : table->m_points) {
+        // Placeholders sort last; points past the end of the audio would only mislead the interpolation
+        if (point.m_sample_offset == UINT64_MAX || (m_num_samples != 0 && point.m_sample_offset >= m_num_samples)
+            || point.m_file_offset >= file_length - audio_start) {
+          break;
+        }
+        m_points.push_back({ point.m_sample_offset, audio_start + point.m_file_offset });
+      }
+    } catch (const std::logic_error &) {
+      // A broken table is only a hint, seeking then works from the bitrate alone
+      m_points.clear();
+    }
+  }
+
+  if (m_num_samples != 0) {
+    m_default_bytes = file_length - audio_start;
+    m_default_samples = m_num_samples;
+  } else if (info.m_max_frame_size != 0) {
+    m_default_bytes = (uint64_t{ info.m_min_frame_size } + info.m_max_frame_size) / 2;
+    m_default_samples = info.m_max_block_size;
+  } else {
+    // Assume the usual 2:1 compression
+    m_default_bytes = uint64_t{ info.m_max_block_size } * info.m_num_channels * info.m_bit_depth / 16;
+    m_default_samples = info.m_max_block_size;
+  }
+  m_default_bytes = std::max<uint64_t>(m_default_bytes, 1);
+  m_default_samples = std::max<uint64_t>(m_default_samples, 1);
+}
+
+void SeekPlanner::record_frame(uint32_t frame_size, uint32_t block_size)
+{
+  m_measured_bytes += frame_size;
+  m_measured_samples += block_size;
+  ++m_measured_frames;
+}
+
+std::pair<SeekPlanner::Point, SeekPlanner::Point> SeekPlanner::get_bracket(uint64_t sample) const
+{
+  Point low{ 0, m_audio_start };
+  Point high{ m_num_samples != 0 ? m_num_samples : UINT64_MAX, m_file_length };
+
+  auto next = std::upper_bound(m_points.begin(), m_points.end(), sample, [](uint64_t val, const Point &point) {
+    return val < point.m_sample_offset;
+  });
+  if (next != m_points.begin()) { low = *(next - 1); }
+  if (next != m_points.end()) { high = *next; }
+  return { low, high };
+}
+
+uint64_t SeekPlanner::get_decode_cost(Point start, uint64_t sample, bool needs_seek) const
+{
+  auto gap = sample > start.m_sample_offset ? sample - start.m_sample_offset : 0;
+  return gap * get_scaled_bytes_per_sample() / SCALE + (needs_seek ? SEEK_COST : 0);
+}
+
+uint64_t SeekPlanner::get_probe_cost() const
+{
+  // Half a frame on average to the next sync code and half a frame from the landing frame to the target, plus as much
+  // again for probes that land a frame short
+  return SEEK_COST + get_average_frame_size() * 3 / 2;
+}
+
+uint64_t SeekPlanner::get_probe_offset(Point low, Point high, uint64_t sample, bool bisect) const
+{
+  auto span = high.m_file_offset - low.m_file_offset;
+  uint64_t offset = low.m_file_offset + span / 2;
+  if (!bisect && high.m_sample_offset != UINT64_MAX && high.m_sample_offset > low.m_sample_offset) {
+    auto fraction = static_cast<double>(sample - low.m_sample_offset)
+                    / static_cast<double>(high.m_sample_offset - low.m_sample_offset);
+    offset = low.m_file_offset + static_cast<uint64_t>(fraction * static_cast<double>(span));
+    // Land before the frame holding sample rather than just after it
+    offset -= std::min(offset, get_average_frame_size());
+  }
+  return std::clamp(offset, low.m_file_offset + 1, high.m_file_offset - 1);
+}
+
+uint64_t SeekPlanner::get_scaled_bytes_per_sample() const
+{
+  if (m_measured_samples != 0) { return m_measured_bytes * SCALE / m_measured_samples; }
+  return m_default_bytes * SCALE / m_default_samples;
+}
+
+uint64_t SeekPlanner::get_average_frame_size() const
+{
+  if (m_measured_frames != 0) { return m_measured_bytes / m_measured_frames; }
+  return m_default_bytes * m_block_size / m_default_samples;
+}
+
+}// namespace flac
@@ -10,7 +10,7 @@
 namespace flac {
 
 SeekableFileFlacInput::SeekableFileFlacInput(const std::string &filename)
-  : m_file_stream(filename, std::ios_base::binary)
+  : m_file_stream(filename, std::ios_base::in | std::ios_base::binary)
 {
   m_file_stream.unsetf(std::ios::skipws);
   m_file_stream.seekg(0, std::ios::end);
@@ -24,15 +24,14 @@ size_t SeekableFileFlacInput::get_length() const { return m_file_length; }
 
 void SeekableFileFlacInput::seek_to(size_t pos)
 {
-  m_file_stream.seekg(static_cast<long>(pos), std::ios::cur);
+  m_file_stream.clear();
+  m_file_stream.seekg(static_cast<long>(pos), std::ios::beg);
   position_changed(pos);
 }
 
 std::optional<uint64_t> SeekableFileFlacInput::read_underlying(std::vector<uint8_t> &buf, size_t off, size_t len)
 {
-  buf.resize(m_file_length);
-  m_file_stream.seekg(static_cast<long>(off), std::ios::cur);
-  m_file_stream.read(reinterpret_cast<char *>(buf.data()), static_cast<long>(len));
+  m_file_stream.read(reinterpret_cast<char *>(buf.data() + off), static_cast<long>(len));
   return m_file_stream.gcount();
 }
 
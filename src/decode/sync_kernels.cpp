@@ -0,0 +1,197 @@
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <flac_codec/common/crc.h>
+#include <flac_codec/decode/sync_kernels.h>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FLAC_CODEC_HAS_SSE2 1
+#endif
+
+namespace flac {
+
+namespace {
+
+  // Sync code, one byte of coded number and the CRC-8
+  const size_t MIN_HEADER_SIZE = 6;
+
+  // Mirrors the checks of FrameInfo::read_frame on the bytes at data, size of which are readable, and returns the coded
+  // number of a valid header
+  std::optional<uint64_t> read_header(const uint8_t *data, size_t size)
+  {
+    if (size < MIN_HEADER_SIZE || data[0] != 0xFF || (data[1] & 0xFEU) != 0xF8) { return std::nullopt; }
+
+    const unsigned block_size_code = data[2] >> 4U;
+    const unsigned sample_rate_code = data[2] & 0xFU;
+    const unsigned chan_asgn = data[3] >> 4U;
+    const unsigned bit_depth_code = (data[3] >> 1U) & 7U;
+    if (block_size_code == 0 || sample_rate_code == 15 || chan_asgn > 10 || bit_depth_code == 3 || bit_depth_code == 7
+        || (data[3] & 1U) != 0) {
+      return std::nullopt;
+    }
+
+    const auto num_leading1s = static_cast<size_t>(std::countl_one(data[4]));
+    if (num_leading1s == 1 || num_leading1s == 8) { return std::nullopt; }
+    size_t len = num_leading1s == 0 ? 5 : 4 + num_leading1s;
+    if (len > size) { return std::nullopt; }
+    uint64_t position = data[4] & (0x7FU >> num_leading1s);
+    for (size_t i = 5; i < len; ++i) {
+      if ((data[i] & 0xC0U) != 0x80U) { return std::nullopt; }
+      position = (position << 6U) | (data[i] & 0x3FU);
+    }
+    // Fixed-size blocks count frames in 31 bits
+    if ((data[1] & 1U) == 0 && (position >> 31U) != 0) { return std::nullopt; }
+
+    len += block_size_code == 6 ? 1 : (block_size_code == 7 ? 2 : 0);
+    len += sample_rate_code == 12 ? 1 : (sample_rate_code == 13 || sample_rate_code == 14 ? 2 : 0);
+    if (len >= size) { return std::nullopt; }
+    if (Crc::update_crc8(0, { data, len }) != data[len]) { return std::nullopt; }
+    return position;
+  }
+
+  void find_scalar(std::span<const uint8_t> data, size_t begin, size_t end, std::vector<size_t> &result)
+  {
+    for (size_t pos = begin; pos < end; ++pos) {
+      const auto *hit = static_cast<const uint8_t *>(std::memchr(data.data() + pos, 0xFF, end - pos));
+      if (hit == nullptr) { break; }
+      pos = static_cast<size_t>(hit - data.data());
+      if (read_header(hit, data.size() - pos).has_value()) { result.push_back(pos); }
+    }
+  }
+
+  // Sync patterns are rare in compressed audio, so the hits of a block are checked one by one
+  void check_hits(std::span<const uint8_t> data, size_t pos, uint32_t hits, std::vector<size_t> &result)
+  {
+    for (; hits != 0; hits &= hits - 1) {
+      auto hit = pos + static_cast<size_t>(std::countr_zero(hits));
+      if (read_header(data.data() + hit, data.size() - hit).has_value()) { result.push_back(hit); }
+    }
+  }
+
+#ifdef FLAC_CODEC_HAS_SSE2
+  // Flags every position of the 16-bit code at once: the bytes against 0xFF and the bytes one further against 0xF8
+  // with the last bit masked off
+  __attribute__((target("sse2"))) inline __m128i match_sse2(const uint8_t *data)
+  {
+    auto first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));// NOLINT
+    auto second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 1));// NOLINT
+    return _mm_and_si128(_mm_cmpeq_epi8(first, _mm_set1_epi8(static_cast<char>(0xFF))),
+      _mm_cmpeq_epi8(_mm_and_si128(second, _mm_set1_epi8(static_cast<char>(0xFE))),
+        _mm_set1_epi8(static_cast<char>(0xF8))));
+  }
+
+  __attribute__((target("avx2"))) inline __m256i match_avx2(const uint8_t *data)
+  {
+    auto first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));// NOLINT
+    auto second = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 1));// NOLINT
+    return _mm256_and_si256(_mm256_cmpeq_epi8(first, _mm256_set1_epi8(static_cast<char>(0xFF))),
+      _mm256_cmpeq_epi8(_mm256_and_si256(second, _mm256_set1_epi8(static_cast<char>(0xFE))),
+        _mm256_set1_epi8(static_cast<char>(0xF8))));
+  }
+
+  // Blocks of 64 bytes are tested with one branch, matches are rare enough that the masks are only extracted then
+  __attribute__((target("sse2"))) void find_sse2(std::span<const uint8_t> data, size_t end, std::vector<size_t> &result)
+  {
+    size_t pos = 0;
+    for (; pos + 64 <= end && pos + 64 < data.size(); pos += 64) {
+      const uint8_t *block = data.data() + pos;
+      auto m0 = match_sse2(block);
+      auto m1 = match_sse2(block + 16);
+      auto m2 = match_sse2(block + 32);
+      auto m3 = match_sse2(block + 48);
+      if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(m0, m1), _mm_or_si128(m2, m3))) == 0) { continue; }
+      check_hits(data, pos, static_cast<uint32_t>(_mm_movemask_epi8(m0)), result);
+      check_hits(data, pos + 16, static_cast<uint32_t>(_mm_movemask_epi8(m1)), result);
+      check_hits(data, pos + 32, static_cast<uint32_t>(_mm_movemask_epi8(m2)), result);
+      check_hits(data, pos + 48, static_cast<uint32_t>(_mm_movemask_epi8(m3)), result);
+    }
+    find_scalar(data, pos, end, result);
+  }
+
+  __attribute__((target("avx2"))) void find_avx2(std::span<const uint8_t> data, size_t end, std::vector<size_t> &result)
+  {
+    size_t pos = 0;
+    for (; pos + 128 <= end && pos + 128 < data.size(); pos += 128) {
+      const uint8_t *block = data.data() + pos;
+      auto m0 = match_avx2(block);
+      auto m1 = match_avx2(block + 32);
+      auto m2 = match_avx2(block + 64);
+      auto m3 = match_avx2(block + 96);
+      auto any = _mm256_or_si256(_mm256_or_si256(m0, m1), _mm256_or_si256(m2, m3));
+      if (_mm256_testz_si256(any, any) != 0) { continue; }
+      check_hits(data, pos, static_cast<uint32_t>(_mm256_movemask_epi8(m0)), result);
+      check_hits(data, pos + 32, static_cast<uint32_t>(_mm256_movemask_epi8(m1)), result);
+      check_hits(data, pos + 64, static_cast<uint32_t>(_mm256_movemask_epi8(m2)), result);
+      check_hits(data, pos + 96, static_cast<uint32_t>(_mm256_movemask_epi8(m3)), result);
+    }
+    find_scalar(data, pos, end, result);
+  }
+
+  bool has_sse2()
+  {
+    static const bool supported = __builtin_cpu_supports("sse2");
+    return supported;
+  }
+
+  bool has_avx2()
+  {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+  }
+#else
+  void find_sse2(std::span<const uint8_t> data, size_t end, std::vector<size_t> &result)
+  {
+    find_scalar(data, 0, end, result);
+  }
+
+  void find_avx2(std::span<const uint8_t> data, size_t end, std::vector<size_t> &result)
+  {
+    find_scalar(data, 0, end, result);
+  }
+
+  bool has_sse2() { return false; }
+
+  bool has_avx2() { return false; }
+#endif
+
+}// namespace
+
+void SyncKernels::find_headers(std::span<const uint8_t> data, size_t end, std::vector<size_t> &result)
+{
+  static const Engine engine = get_engine();
+  find_headers(data, end, result, engine);
+}
+
+void SyncKernels::find_headers(std::span<const uint8_t> data, size_t end, std::vector<size_t> &result, Engine engine)
+{
+  if (end > data.size()) { throw std::invalid_argument("Search end is out of bounds"); }
+
+  if (engine == Engine::Avx2 && has_avx2()) {
+    find_avx2(data, end, result);
+  } else if (engine != Engine::Scalar && has_sse2()) {
+    find_sse2(data, end, result);
+  } else {
+    find_scalar(data, 0, end, result);
+  }
+}
+
+bool SyncKernels::is_header(std::span<const uint8_t> data) { return read_header(data.data(), data.size()).has_value(); }
+
+std::optional<uint64_t> SyncKernels::get_header_position(std::span<const uint8_t> data)
+{
+  return read_header(data.data(), data.size());
+}
+
+SyncKernels::Engine SyncKernels::get_engine()
+{
+  if (has_avx2()) { return Engine::Avx2; }
+  return has_sse2() ? Engine::Sse2 : Engine::Scalar;
+}
+
+}// namespace flac
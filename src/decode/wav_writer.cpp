@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <flac_codec/decode/pcm_kernels.h>
+#include <flac_codec/decode/wav_writer.h>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace flac {
+
+namespace {
+
+  // O_DIRECT needs the buffer address, the length and the file offset of every write aligned to the logical block
+  // size of the device; 4096 covers the common ones
+  const size_t ALIGNMENT = 4096;
+  const size_t MIN_BUFFER_SIZE = 64U << 10U;
+
+  // The JUNK chunk right after the RIFF header reserves room for ds64
+  const size_t DS64_OFFSET = 12;
+  const uint32_t DS64_SIZE = 28;
+  const uint32_t FMT_PCM_SIZE = 16;
+  const uint32_t FMT_EXTENSIBLE_SIZE = 40;
+  const uint64_t MAX_RIFF_SIZE = 0xFFFFFFFF;
+
+  // Speaker positions FLAC assigns by channel count, as WAVEFORMATEXTENSIBLE masks
+  const std::array<uint32_t, 8> DEFAULT_CHANNEL_MASKS{ 0x4, 0x3, 0x7, 0x33, 0x37, 0x3F, 0x70F, 0x63F };
+
+  // KSDATAFORMAT_SUBTYPE_PCM
+  const std::array<uint8_t, 16> PCM_SUBFORMAT{
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+  };
+
+  class HeaderBuilder
+  {
+  public:
+    explicit HeaderBuilder(std::byte *data) : m_data(data) {}
+
+    void put_tag(const char *tag)
+    {
+      std::memcpy(m_data + m_len, tag, 4);
+      m_len += 4;
+    }
+
+    template<typename T> void put(T val)
+    {
+      for (size_t i = 0; i < sizeof(T); ++i) {
+        m_data[m_len++] = static_cast<std::byte>(static_cast<uint64_t>(val) >> (8 * i));
+      }
+    }
+
+    void put_bytes(std::span<const uint8_t> bytes)
+    {
+      std::memcpy(m_data + m_len, bytes.data(), bytes.size());
+      m_len += bytes.size();
+    }
+
+    [[nodiscard]] size_t get_length() const { return m_len; }
+
+  private:
+    std::byte *m_data;
+    size_t m_len{};
+  };
+
+}// namespace
+
+void WavWriter::AlignedDelete::operator()(std::byte *ptr) const
+{
+  ::operator delete[](ptr, std::align_val_t{ ALIGNMENT });
+}
+
+WavWriter::WavWriter(const std::string &filename,
+  uint32_t sample_rate,
+  uint32_t num_channels,
+  uint32_t bit_depth,
+  Mode mode,
+  size_t buffer_size)
+  : m_fd(-1), m_mode(mode), m_num_channels(num_channels), m_frame_size(0), m_encoding(get_encoding(bit_depth)),
+    m_buffer_size(0), m_buffer_len(0), m_header_size(0), m_file_pos(0), m_num_frames(0)
+{
+  if (num_channels < 1 || num_channels > DEFAULT_CHANNEL_MASKS.size()) {
+    throw std::invalid_argument("Number of channels is invalid");
+  }
+  if (bit_depth < 1 || bit_depth > 32) { throw std::invalid_argument("Bit depth is invalid"); }
+  if (sample_rate == 0) { throw std::invalid_argument("Sample rate is invalid"); }
+
+  m_frame_size = PcmKernels::get_sample_size(m_encoding) * num_channels;
+  m_buffer_size = (std::max(buffer_size, MIN_BUFFER_SIZE) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  m_buffer.reset(static_cast<std::byte *>(::operator new[](m_buffer_size, std::align_val_t{ ALIGNMENT })));
+
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;// NOLINT
+  if (m_mode == Mode::Direct) {
+    m_fd = ::open(filename.c_str(), flags | O_DIRECT, 0644);// NOLINT
+    if (m_fd < 0 && errno == EINVAL) { m_mode = Mode::Buffered; }
+  }
+  if (m_mode == Mode::Buffered) { m_fd = ::open(filename.c_str(), flags, 0644); }// NOLINT
+  if (m_fd < 0) {
+    const std::string msg{ "Failed to open " + filename + ": " + std::strerror(errno) };
+    throw std::runtime_error(msg);
+  }
+
+  // The header goes out with the first buffer, which keeps every O_DIRECT write aligned
+  write_header(sample_rate, bit_depth);
+}
+
+WavWriter::~WavWriter() { close(); }
+
+PcmKernels::Encoding WavWriter::get_encoding(uint32_t bit_depth)
+{
+  if (bit_depth <= 16) { return PcmKernels::Encoding::S16; }
+  if (bit_depth <= 24) { return PcmKernels::Encoding::S24; }
+  return PcmKernels::Encoding::S32;
+}
+
+void WavWriter::write_header(uint32_t sample_rate, uint32_t bit_depth)
+{
+  auto container_bits = static_cast<uint16_t>(PcmKernels::get_sample_size(m_encoding) * 8);
+  // Plain PCM is ambiguous beyond two channels and for samples that do not fill their container
+  const bool extensible = m_num_channels > 2 || container_bits > 16 || container_bits != bit_depth;
+
+  HeaderBuilder header(m_buffer.get());
+  header.put_tag("RIFF");
+  header.put<uint32_t>(0);
+  header.put_tag("WAVE");
+
+  header.put_tag("JUNK");
+  header.put<uint32_t>(DS64_SIZE);
+  for (size_t i = 0; i < DS64_SIZE; ++i) { header.put<uint8_t>(0); }
+
+  header.put_tag("fmt ");
+  header.put<uint32_t>(extensible ? FMT_EXTENSIBLE_SIZE : FMT_PCM_SIZE);
+  header.put<uint16_t>(extensible ? 0xFFFE : 1);
+  header.put<uint16_t>(static_cast<uint16_t>(m_num_channels));
+  header.put<uint32_t>(sample_rate);
+  header.put<uint32_t>(static_cast<uint32_t>(sample_rate * m_frame_size));
+  header.put<uint16_t>(static_cast<uint16_t>(m_frame_size));
+  header.put<uint16_t>(container_bits);
+  if (extensible) {
+    header.put<uint16_t>(22);
+    header.put<uint16_t>(static_cast<uint16_t>(bit_depth));
+    header.put<uint32_t>(DEFAULT_CHANNEL_MASKS.at(m_num_channels - 1));
+    header.put_bytes(PCM_SUBFORMAT);
+  }
+
+  header.put_tag("data");
+  header.put<uint32_t>(0);
+
+  m_header_size = header.get_length();
+  m_buffer_len = m_header_size;
+}
+
+PcmBuffer WavWriter::get_buffer(size_t min_frames)
+{
+  if ((m_buffer_size - m_buffer_len) / m_frame_size < min_frames) { flush(false); }
+
+  auto num_frames = (m_buffer_size - m_buffer_len) / m_frame_size;
+  if (num_frames < min_frames) { throw std::invalid_argument("Write buffer too small"); }
+
+  const std::span<std::byte> free{ m_buffer.get() + m_buffer_len, num_frames * m_frame_size };
+  return { free, m_encoding, true, m_num_channels };
+}
+
+void WavWriter::commit(size_t num_frames)
+{
+  if (num_frames > (m_buffer_size - m_buffer_len) / m_frame_size) {
+    throw std::invalid_argument("Committed more frames than the buffer holds");
+  }
+  m_buffer_len += num_frames * m_frame_size;
+  m_num_frames += num_frames;
+}
+
+void WavWriter::write(std::span<const std::byte> pcm)
+{
+  if (pcm.size() % m_frame_size != 0) { throw std::invalid_argument("PCM data is not a whole number of frames"); }
+  m_num_frames += pcm.size() / m_frame_size;
+
+  // Large writes skip the buffer: one writev gathers what is buffered and the caller's data without a copy
+  if (m_mode == Mode::Buffered && m_buffer_len + pcm.size() > m_buffer_size) {
+    write_fully(m_buffer.get(), m_buffer_len, pcm.data(), pcm.size());
+    m_buffer_len = 0;
+    return;
+  }
+
+  while (!pcm.empty()) {
+    if (m_buffer_len == m_buffer_size) { flush(false); }
+    auto len = std::min(pcm.size(), m_buffer_size - m_buffer_len);
+    std::memcpy(m_buffer.get() + m_buffer_len, pcm.data(), len);
+    m_buffer_len += len;
+    pcm = pcm.subspan(len);
+  }
+}
+
+void WavWriter::finish()
+{
+  if (m_fd < 0) { throw std::runtime_error("Writer already closed"); }
+
+  // The tail is not a multiple of the alignment, so it is written through the page cache
+  if (m_mode == Mode::Direct) {
+    const int flags = ::fcntl(m_fd, F_GETFL);// NOLINT
+    if (flags < 0 || ::fcntl(m_fd, F_SETFL, flags & ~O_DIRECT) != 0) {// NOLINT
+      const std::string msg{ std::string("Failed to clear O_DIRECT: ") + std::strerror(errno) };
+      throw std::runtime_error(msg);
+    }
+    m_mode = Mode::Buffered;
+  }
+
+  // RIFF chunks are padded to an even size
+  if ((m_num_frames * m_frame_size) % 2 != 0) {
+    if (m_buffer_len == m_buffer_size) { flush(true); }
+    m_buffer[m_buffer_len++] = std::byte{ 0 };
+  }
+  flush(true);
+  patch_header();
+
+  auto status = ::close(m_fd);
+  m_fd = -1;
+  if (status != 0) {
+    const std::string msg{ std::string("Failed to close WAV file: ") + std::strerror(errno) };
+    throw std::runtime_error(msg);
+  }
+}
+
+uint64_t WavWriter::get_num_frames() const { return m_num_frames; }
+
+void WavWriter::flush(bool all)
+{
+  auto len = m_buffer_len;
+  if (!all && m_mode == Mode::Direct) { len = len / ALIGNMENT * ALIGNMENT; }
+
+  write_fully(m_buffer.get(), len, nullptr, 0);
+  std::memmove(m_buffer.get(), m_buffer.get() + len, m_buffer_len - len);
+  m_buffer_len -= len;
+}
+
+void WavWriter::write_fully(const std::byte *head, size_t head_len, const std::byte *tail, size_t tail_len)
+{
+  std::array<iovec, 2> iov{ { { const_cast<std::byte *>(head), head_len },// NOLINT
+    { const_cast<std::byte *>(tail), tail_len } } };// NOLINT
+  m_file_pos += head_len + tail_len;
+
+  size_t idx = 0;
+  while (idx < iov.size()) {
+    auto written = ::writev(m_fd, iov.data() + idx, static_cast<int>(iov.size() - idx));
+    if (written < 0) {
+      if (errno == EINTR) { continue; }
+      const std::string msg{ std::string("Failed to write WAV data: ") + std::strerror(errno) };
+      throw std::runtime_error(msg);
+    }
+
+    auto done = static_cast<size_t>(written);
+    while (idx < iov.size() && done >= iov.at(idx).iov_len) {
+      done -= iov.at(idx).iov_len;
+      ++idx;
+    }
+    if (idx < iov.size()) {
+      iov.at(idx).iov_base = static_cast<std::byte *>(iov.at(idx).iov_base) + done;
+      iov.at(idx).iov_len -= done;
+    }
+  }
+}
+
+void WavWriter::patch_header()
+{
+  auto data_size = m_num_frames * m_frame_size;
+  auto riff_size = m_file_pos - 8;
+  const bool rf64 = riff_size > MAX_RIFF_SIZE;
+
+  std::array<std::byte, DS64_OFFSET + 8 + DS64_SIZE> head{};
+  HeaderBuilder header(head.data());
+  if (rf64) {
+    header.put_tag("RF64");
+    header.put<uint32_t>(0xFFFFFFFF);
+    header.put_tag("WAVE");
+    header.put_tag("ds64");
+    header.put<uint32_t>(DS64_SIZE);
+    header.put<uint64_t>(riff_size);
+    header.put<uint64_t>(data_size);
+    header.put<uint64_t>(m_num_frames);
+    header.put<uint32_t>(0);
+  } else {
+    header.put_tag("RIFF");
+    header.put<uint32_t>(static_cast<uint32_t>(riff_size));
+  }
+
+  // Oversized data chunks defer to ds64
+  std::array<std::byte, 4> data_len{};
+  HeaderBuilder data_header(data_len.data());
+  data_header.put<uint32_t>(rf64 ? 0xFFFFFFFF : static_cast<uint32_t>(data_size));
+
+  if (::pwrite(m_fd, head.data(), header.get_length(), 0) != static_cast<ssize_t>(header.get_length())
+      || ::pwrite(m_fd, data_len.data(), data_len.size(), static_cast<off_t>(m_header_size - 4)) != 4) {
+    const std::string msg{ std::string("Failed to write WAV header: ") + std::strerror(errno) };
+    throw std::runtime_error(msg);
+  }
+}
+
+void WavWriter::close()
+{
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+}// namespace flac
@@ -1,39 +1,217 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <exception>
 #include <flac_codec/common/stream_info.h>
 #include <flac_codec/decode/flac_decoder.h>
+#include <flac_codec/decode/loudness_analyzer.h>
+#include <flac_codec/decode/parallel_flac_decoder.h>
+#include <flac_codec/decode/pcm_kernels.h>
+#include <flac_codec/decode/peak_generator.h>
+#include <flac_codec/decode/wav_writer.h>
+#include <iomanip>
 #include <iostream>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
+namespace {
+
+// Fills buf with whole blocks while another one of max_block_size is sure to fit and returns the number of frames
+// written, 0 at the end of the stream
+size_t decode_blocks(flac::FlacDecoder &dec, const flac::PcmBuffer &buf, size_t max_block_size)
+{
+  size_t frames = 0;
+  while (buf.get_frame_capacity() - frames >= max_block_size) {
+    auto len = dec.read_audio_block(buf, frames);
+    if (len == 0) { break; }
+    frames += len;
+  }
+  return frames;
+}
+
+// Interleaved little-endian PCM. Memory is bounded by one chunk of whole blocks, so it does not grow with the length
+// of the stream and an unknown length (m_num_samples == 0) needs no special casing.
+uint64_t decode_to_stdout(flac::FlacDecoder &dec)
+{
+  const size_t chunk_size = size_t{ 1 } << 20U;
+
+  const flac::StreamInfo &info = *dec.m_stream_info;
+  auto encoding = flac::WavWriter::get_encoding(info.m_bit_depth);
+  auto frame_bytes = flac::PcmKernels::get_sample_size(encoding) * info.m_num_channels;
+  // StreamInfo rejects maximum block sizes below 16, so the chunk always takes at least one block
+  auto max_block_size = size_t(info.m_max_block_size);
+  auto num_blocks = std::max<size_t>(1, chunk_size / (max_block_size * frame_bytes));
+
+  std::vector<std::byte> chunk(num_blocks * max_block_size * frame_bytes);
+  const flac::PcmBuffer buf{ chunk, encoding, true, info.m_num_channels };
+
+  uint64_t total = 0;
+  for (size_t frames = 0; (frames = decode_blocks(dec, buf, max_block_size)) != 0; total += frames) {
+    const auto *bytes = reinterpret_cast<const char *>(chunk.data());// NOLINT
+    std::cout.write(bytes, static_cast<std::streamsize>(frames * frame_bytes));
+    if (!std::cout) { throw std::runtime_error("Failed to write output"); }
+  }
+  std::cout.flush();
+  return total;
+}
+
+// The decoder formats straight into the writer's buffer, which goes out in large aligned writes
+uint64_t decode_to_wav(flac::FlacDecoder &dec, const std::string &out_file, flac::WavWriter::Mode mode)
+{
+  const flac::StreamInfo &info = *dec.m_stream_info;
+  flac::WavWriter writer(out_file, info.m_sample_rate, info.m_num_channels, info.m_bit_depth, mode);
+
+  auto max_block_size = size_t(info.m_max_block_size);
+  size_t frames = 0;
+  do {
+    frames = decode_blocks(dec, writer.get_buffer(max_block_size), max_block_size);
+    writer.commit(frames);
+  } while (frames != 0);
+
+  writer.finish();
+  return writer.get_num_frames();
+}
+
+// Frames are located up front and decoded a window at a time, each window straight into the writer's buffer
+uint64_t decode_to_wav_parallel(flac::ParallelFlacDecoder &dec,
+  const std::string &out_file,
+  flac::WavWriter::Mode mode,
+  unsigned num_threads)
+{
+  const flac::StreamInfo &info = dec.get_stream_info();
+  const auto &frames = dec.get_frames();
+
+  // Enough blocks per window for every thread to claim several batches, but no more PCM than the byte budget per
+  // thread, which large blocks of many wide channels would otherwise blow past. Always room for one whole block.
+  const size_t bytes_per_thread = size_t{ 4 } << 20U;
+  auto max_block_size = size_t(info.m_max_block_size);
+  auto frame_bytes = flac::PcmKernels::get_sample_size(flac::WavWriter::get_encoding(info.m_bit_depth))
+                     * info.m_num_channels;
+  auto batch_window = size_t(num_threads) * flac::ParallelFlacDecoder::FRAMES_PER_BATCH * 4 * max_block_size;
+  auto window = std::max(max_block_size, std::min(batch_window, size_t(num_threads) * bytes_per_thread / frame_bytes));
+  auto buffer_size = std::max(flac::WavWriter::DEFAULT_BUFFER_SIZE, 2 * window * frame_bytes);
+  flac::WavWriter writer(out_file, info.m_sample_rate, info.m_num_channels, info.m_bit_depth, mode, buffer_size);
+
+  for (size_t first = 0; first < frames.size();) {
+    auto buf = writer.get_buffer(window);
+    auto base = frames[first].m_sample_offset;
+    auto end = first;
+    while (end < frames.size() && frames[end].m_sample_offset + frames[end].m_block_size - base <= window) { ++end; }
+    // A block over STREAMINFO's maximum then fails in decode() instead of stalling the loop
+    end = std::max(end, first + 1);
+
+    dec.decode(buf, first, end - first);
+    writer.commit(frames[end - 1].m_sample_offset + frames[end - 1].m_block_size - base);
+    first = end;
+  }
+
+  writer.finish();
+  return writer.get_num_frames();
+}
+
+void print_loudness(const flac::LoudnessResult &result)
+{
+  std::cout << std::fixed << std::setprecision(2);
+  if (result.m_integrated_loudness.has_value()) {
+    std::cout << "Integrated loudness: " << result.m_integrated_loudness.value() << " LUFS\n"
+              << "Track gain: " << result.m_track_gain.value() << " dB\n";
+  } else {
+    std::cout << "Integrated loudness: none, every block is under the gates\n";
+  }
+  std::cout << "True peak: " << 20 * std::log10(result.m_true_peak) << " dBTP\n"
+            << std::setprecision(6) << "Track peak: " << result.m_sample_peak << "\n";
+}
+
+}// namespace
+
 int main(int argc, char *argv[])
 {
-  if (argc != 2) {
-    // NOLINTNEXTLINE
-    std::cerr << "Usage: " << argv[0] << " <input.flac> <output.wav>\n";
+  const std::span<char *> args{ argv, static_cast<size_t>(argc) };
+  bool direct = false;
+  unsigned num_threads = 1;
+  uint32_t bucket_size = 0;
+  unsigned frame_step = 1;
+  bool valid = args.size() >= 3;
+  const bool loudness = valid && std::string(args[2]) == "--loudness";
+  for (size_t i = 3; valid && i < args.size(); ++i) {
+    const std::string arg = args[i];
+    if (arg == "--direct") {
+      direct = true;
+    } else if (arg == "--threads" && i + 1 < args.size()) {
+      num_threads = static_cast<unsigned>(std::strtoul(args[++i], nullptr, 10));
+    } else if (arg == "--peaks" && i + 1 < args.size()) {
+      bucket_size = static_cast<uint32_t>(std::strtoul(args[++i], nullptr, 10));
+      valid = bucket_size != 0;
+    } else if (arg == "--coarse" && i + 1 < args.size()) {
+      frame_step = static_cast<unsigned>(std::strtoul(args[++i], nullptr, 10));
+      valid = frame_step != 0;
+    } else {
+      valid = false;
+    }
+  }
+  // Peaks go to a file of their own, and --coarse only applies to them
+  if (valid && (bucket_size != 0 ? std::string(args[2]) == "-" : frame_step != 1)) { valid = false; }
+  if (loudness && (direct || bucket_size != 0)) { valid = false; }
+  if (!valid) {
+    std::cerr << "Usage: " << args[0] << " <input.flac> <output.wav | -> [--direct] [--threads N, 0 for all cores]\n"
+              << "       " << args[0] << " <input.flac> <output.pks> --peaks BUCKET_SIZE [--coarse FRAME_STEP]"
+              << " [--threads N]\n"
+              << "       " << args[0] << " <input.flac> --loudness [--threads N]\n";
     return EXIT_FAILURE;
   }
+  if (num_threads == 0) { num_threads = std::max(1U, std::thread::hardware_concurrency()); }
 
-  const std::string in_file = argv[1];// NOLINT
-  // const std::string out_file = argv[2];
-
-  flac::StreamInfo stream_info;
-  flac::Samples samples;
+  const std::string in_file = args[1];
+  const std::string out_file = args[2];
 
   try {
-    flac::FlacDecoder dec(in_file);
+    auto mode = direct ? flac::WavWriter::Mode::Direct : flac::WavWriter::Mode::Buffered;
+    uint64_t num_samples = 0;
+    uint64_t expected = 0;
+
+    if (loudness && num_threads > 1) {
+      print_loudness(flac::LoudnessAnalyzer::analyze(in_file, flac::ValidationLevel::Strict, num_threads));
+      return EXIT_SUCCESS;
+    }
+    if (loudness) {
+      flac::FlacDecoder dec(in_file);
+      while (dec.read_and_handle_metadata_block().has_value()) {}
+      print_loudness(flac::LoudnessAnalyzer::analyze(dec));
+      return EXIT_SUCCESS;
+    }
+
+    if (bucket_size != 0) {
+      flac::PeakGenerator gen(in_file, flac::ValidationLevel::Strict, num_threads);
+      gen.generate(bucket_size, frame_step).save(out_file);
+      return EXIT_SUCCESS;
+    }
 
-    while (!dec.read_and_handle_metadata_block().has_value()) {}
-    stream_info = *dec.m_stream_info;
-    if (stream_info.m_bit_depth % 8 != 0) { throw std::runtime_error("Only whole-byte sample depth supported"); }
+    if (num_threads > 1 && out_file != "-") {
+      flac::ParallelFlacDecoder dec(in_file, flac::ValidationLevel::Strict, num_threads);
+      expected = dec.get_stream_info().m_num_samples;
+      num_samples = decode_to_wav_parallel(dec, out_file, mode, num_threads);
+    } else {
+      flac::FlacDecoder dec(in_file);
+      while (dec.read_and_handle_metadata_block().has_value()) {}
+      if (dec.m_stream_info == nullptr) { throw std::runtime_error("Missing stream info metadata block"); }
+      expected = dec.m_stream_info->m_num_samples;
+
+      // "-" streams raw PCM to stdout, which cannot be seeked back to patch a WAV header
+      if (out_file == "-") {
+        num_samples = decode_to_stdout(dec);
+      } else {
+        num_samples = decode_to_wav(dec, out_file, mode);
+      }
+    }
 
-    samples.resize(stream_info.m_num_channels, std::vector<int64_t>(stream_info.m_num_samples));
-    for (size_t off = 0;;) {
-      auto len = dec.read_audio_block(samples, off);
-      if (len == 0) { break; }
-      off += len;
+    if (expected != 0 && num_samples != expected) {
+      throw std::runtime_error("Decoded " + std::to_string(num_samples) + " samples, STREAMINFO declares "
+                               + std::to_string(expected));
     }
   } catch (const std::exception &e) {
     std::cerr << e.what() << "\n";
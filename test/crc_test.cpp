@@ -0,0 +1,73 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <flac_codec/common/crc.h>
+#include <iostream>
+#include <span>
+#include <vector>
+
+using namespace flac;
+
+namespace {
+
+  // Every length up to here, which covers the tails and the first few folds of each engine
+  const size_t MAX_LENGTH = 1024;
+  // Start offsets within a cache line, so each engine sees every alignment of its wide loads
+  const size_t NUM_ALIGNMENTS = 64;
+  const std::array<Crc::Engine, 2> ENGINES{ Crc::Engine::Slice8, Crc::Engine::Clmul };
+
+  // Published check values of CRC-8/SMBUS and CRC-16/UMTS, the two FLAC uses, over "123456789"
+  int check_reference()
+  {
+    const std::array<uint8_t, 9> digits{ '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    if (Crc::update_crc8(0, digits, Crc::Engine::Table) != 0xF4
+        || Crc::update_crc16(0, digits, Crc::Engine::Table) != 0xFEE8) {
+      std::cerr << "table engine does not match the check values\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  // Compares each engine with the table one, from a running CRC that changes with every case
+  int check_engines()
+  {
+    std::vector<uint8_t> bytes(MAX_LENGTH + NUM_ALIGNMENTS);
+    uint32_t state = 1;
+    for (auto &byte : bytes) {
+      state = state * 1664525U + 1013904223U;
+      byte = static_cast<uint8_t>(state >> 24U);
+    }
+
+    int failures = 0;
+    for (size_t len = 0; len <= MAX_LENGTH; ++len) {
+      for (size_t offset = 0; offset < NUM_ALIGNMENTS; ++offset) {
+        auto data = std::span<const uint8_t>(bytes).subspan(offset, len);
+        auto crc8 = static_cast<uint8_t>(len * 7 + offset);
+        auto crc16 = static_cast<uint16_t>(len * 4099 + offset);
+        auto expected8 = Crc::update_crc8(crc8, data, Crc::Engine::Table);
+        auto expected16 = Crc::update_crc16(crc16, data, Crc::Engine::Table);
+        for (auto engine : ENGINES) {
+          if (Crc::update_crc8(crc8, data, engine) != expected8
+              || Crc::update_crc16(crc16, data, engine) != expected16) {
+            std::cerr << "engine " << static_cast<int>(engine) << " differs at length " << len << ", offset " << offset
+                      << "\n";
+            ++failures;
+          }
+        }
+        if (Crc::update_crc8(crc8, data) != expected8 || Crc::update_crc16(crc16, data) != expected16) {
+          std::cerr << "default engine differs at length " << len << ", offset " << offset << "\n";
+          ++failures;
+        }
+      }
+    }
+    return failures;
+  }
+
+}// namespace
+
+int main()
+{
+  auto failures = check_reference() + check_engines();
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,69 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <flac_codec/decode/flac_decoder.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "stream_builder.h"
+
+using namespace flac;
+
+namespace {
+
+  const size_t NUM_SAMPLES = 30000;
+  const uint32_t BLOCK_SIZE = 1152;
+  const size_t NUM_SEEKS = 200;
+
+  // Seeks to pseudo-random positions, backwards and forwards, and compares what comes back with the encoded samples
+  template<typename Buffer> int check_seeks(uint32_t bit_depth, uint8_t channel_assignment, const std::string &name)
+  {
+    StreamSpec spec;
+    spec.m_bit_depth = bit_depth;
+    spec.m_block_size = BLOCK_SIZE;
+    spec.m_channel_assignment = channel_assignment;
+    auto channels = make_noise(2, NUM_SAMPLES, bit_depth, bit_depth);
+    const TempFile file("flac_codec_decoder_seek.flac", encode_stream(spec, channels).m_bytes);
+
+    FlacDecoder dec(file.get_path());
+    while (dec.read_and_handle_metadata_block().has_value()) {}
+    Buffer out(2, typename Buffer::value_type(BLOCK_SIZE));
+    uint64_t state = 1;
+    try {
+      for (size_t i = 0; i < NUM_SEEKS; ++i) {
+        state = state * 6364136223846793005U + 1442695040888963407U;
+        auto pos = (state >> 16U) % NUM_SAMPLES;
+        auto len = dec.seek_and_read_audio_block(pos, out, 0);
+        if (len == 0 || len > BLOCK_SIZE - pos % BLOCK_SIZE) {
+          std::cerr << name << ", depth " << bit_depth << ": " << len << " samples at " << pos << "\n";
+          return 1;
+        }
+        for (size_t ch = 0; ch < 2; ++ch) {
+          for (size_t j = 0; j < len; ++j) {
+            if (out[ch][j] != channels[ch][pos + j]) {
+              std::cerr << name << ", depth " << bit_depth << ": sample " << pos + j << " of channel " << ch
+                        << " differs\n";
+              return 1;
+            }
+          }
+        }
+      }
+    } catch (const std::exception &e) {
+      std::cerr << name << ", depth " << bit_depth << ": " << e.what() << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+}// namespace
+
+int main()
+{
+  // Streams up to 31 bits seek through 32-bit scratch space, a 32-bit stream with a side channel through 64-bit
+  auto failures = check_seeks<Samples>(16, 1, "Samples") + check_seeks<Samples32>(16, 1, "Samples32")
+                  + check_seeks<Samples>(31, 10, "Samples") + check_seeks<Samples32>(31, 10, "Samples32")
+                  + check_seeks<Samples>(32, 8, "Samples") + check_seeks<Samples32>(32, 8, "Samples32");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,71 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <flac_codec/common/crc.h>
+#include <flac_codec/decode/byte_flac_input.h>
+#include <iostream>
+#include <span>
+#include <vector>
+
+using namespace flac;
+
+namespace {
+
+  // Size of the byte buffer FlacLowLevelInput refills
+  const size_t WINDOW = 4096;
+  // Bytes after a candidate 0xFF: both sync codes, a near miss, a plain byte and another candidate
+  const std::array<uint8_t, 5> SECOND_BYTES{ 0xF8, 0xF9, 0xFA, 0x00, 0xFF };
+
+  bool is_sync_code(const std::vector<uint8_t> &bytes, size_t pos)
+  {
+    return bytes[pos] == 0xFF && pos + 1 < bytes.size() && (bytes[pos + 1] & 0xFEU) == 0xF8;
+  }
+
+  // Walks the sync codes the way FrameDecoder::find_frame_end does and checks every stop and the CRC-16 up to it
+  int check_sync_walk(const std::vector<uint8_t> &bytes)
+  {
+    ByteFlacInput input(bytes);
+    input.reset_crcs();
+    size_t expected = 0;
+    while (true) {
+      while (expected < bytes.size() && !is_sync_code(bytes, expected)) { ++expected; }
+      const bool found = input.skip_to_sync_code();
+      auto pos = input.get_position();
+      auto crc = Crc::update_crc16(0, std::span(bytes).first(expected), Crc::Engine::Table);
+      if (found != (expected < bytes.size()) || pos != expected || input.get_crc16() != crc) {
+        std::cerr << "sync walk stopped at " << pos << ", expected " << expected << "\n";
+        return 1;
+      }
+      if (!found) { return 0; }
+      input.read_uint(8);
+      ++expected;
+    }
+  }
+
+  // Candidate first bytes at and around the end of the first window, followed by codes and near misses
+  int check_window_edges()
+  {
+    int failures = 0;
+    for (size_t first = WINDOW - 3; first <= WINDOW + 1; ++first) {
+      for (const auto second : SECOND_BYTES) {
+        std::vector<uint8_t> bytes(3 * WINDOW);
+        for (size_t i = 0; i < bytes.size(); ++i) { bytes[i] = static_cast<uint8_t>((i * 131) % 251); }
+        bytes[first] = 0xFF;
+        bytes[first + 1] = second;
+        bytes[first + 2] = 0xF8;
+        bytes[2 * WINDOW - 1] = 0xFF;
+        bytes[2 * WINDOW] = 0xF9;
+        failures += check_sync_walk(bytes);
+      }
+    }
+    return failures;
+  }
+
+}// namespace
+
+int main()
+{
+  auto failures = check_window_edges();
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,127 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <flac_codec/common/crc.h>
+#include <flac_codec/decode/data_format_exception.h>
+#include <flac_codec/decode/flac_decoder.h>
+#include <iostream>
+#include <span>
+#include <vector>
+
+#include "stream_builder.h"
+
+using namespace flac;
+
+namespace {
+
+  const size_t NUM_SAMPLES = 20000;
+  // Size of the byte buffer FlacLowLevelInput refills
+  const size_t WINDOW = 4096;
+  // Past the frame header and the subframe header
+  const size_t HEADER_BYTES = 16;
+  // Several frames for each of the 32-bit streams
+  const uint32_t WIDE_BLOCK_SIZE = 1000;
+  // Where the fake frame ends go, relative to each window edge inside the frame, so some of the headers after them are
+  // cut off by the edge and some are not
+  const std::array<int, 5> EDGE_OFFSETS{ -40, -16, -9, -2, 5 };
+  // A sync code followed by the reserved block size code, so the header there is never valid
+  const std::array<uint8_t, 4> FAKE_HEADER{ 0xFF, 0xF8, 0x00, 0x00 };
+
+  // Turns the bytes at pos into a point where the CRC-16 from the start of the frame is zero and a sync code follows,
+  // then mends the footer so the frame itself still checks out
+  void plant_fake_end(std::vector<uint8_t> &bytes, size_t frame_start, size_t frame_end, size_t pos)
+  {
+    auto crc = Crc::update_crc16(0, std::span(bytes).subspan(frame_start, pos - frame_start));
+    bytes[pos] = static_cast<uint8_t>(crc >> 8U);
+    bytes[pos + 1] = static_cast<uint8_t>(crc & 0xFFU);
+    for (size_t i = 0; i < FAKE_HEADER.size(); ++i) { bytes[pos + 2 + i] = FAKE_HEADER.at(i); }
+    auto footer = Crc::update_crc16(0, std::span(bytes).subspan(frame_start, frame_end - 2 - frame_start));
+    bytes[frame_end - 2] = static_cast<uint8_t>(footer >> 8U);
+    bytes[frame_end - 1] = static_cast<uint8_t>(footer & 0xFFU);
+  }
+
+  // A CRC-16 of zero at a sync code inside a frame used to be taken as the end of the frame
+  int check_fake_frame_ends(FlacDecoder::InputType input_type, uint32_t bit_depth, uint32_t block_size)
+  {
+    StreamSpec spec;
+    spec.m_bit_depth = bit_depth;
+    spec.m_block_size = block_size;
+    spec.m_channel_assignment = 0;
+    auto stream = encode_stream(spec, make_noise(1, NUM_SAMPLES, spec.m_bit_depth, 3));
+    const auto &offsets = stream.m_frame_offsets;
+    for (size_t frame = 0; frame + 1 < offsets.size(); ++frame) {
+      for (size_t edge = (offsets[frame] / WINDOW + 1) * WINDOW; edge < offsets[frame + 1]; edge += WINDOW) {
+        for (const auto offset : EDGE_OFFSETS) {
+          auto pos = static_cast<size_t>(static_cast<int64_t>(edge) + offset);
+          if (pos > offsets[frame] + HEADER_BYTES && pos + 8 < offsets[frame + 1]) {
+            plant_fake_end(stream.m_bytes, offsets[frame], offsets[frame + 1], pos);
+          }
+        }
+      }
+    }
+    const TempFile file("flac_codec_frame_decoder_fake_end.flac", stream.m_bytes);
+
+    FlacDecoder dec(file.get_path(), input_type);
+    while (dec.read_and_handle_metadata_block().has_value()) {}
+    size_t count = 0;
+    try {
+      while (auto frame = dec.skim_audio_block()) {
+        if (count >= offsets.size() || frame->m_file_offset != offsets[count]) { break; }
+        ++count;
+      }
+    } catch (const DataFormatException &e) {
+      std::cerr << e.what() << "\n";
+    }
+    if (count != offsets.size()) {
+      std::cerr << "input " << static_cast<int>(input_type) << ", depth " << bit_depth << ": " << count
+                << " frames skimmed, expected " << offsets.size() << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  // The side channel of a 32-bit stream is 33 bits wide, past what read_signed_int takes
+  int check_wide_side_channel(uint8_t channel_assignment)
+  {
+    StreamSpec spec;
+    spec.m_bit_depth = 32;
+    spec.m_block_size = WIDE_BLOCK_SIZE;
+    spec.m_channel_assignment = channel_assignment;
+    auto channels = make_noise(2, NUM_SAMPLES, spec.m_bit_depth, channel_assignment);
+    const TempFile file("flac_codec_frame_decoder_wide_side.flac", encode_stream(spec, channels).m_bytes);
+
+    FlacDecoder dec(file.get_path());
+    while (dec.read_and_handle_metadata_block().has_value()) {}
+    Samples decoded(2, std::vector<int64_t>(NUM_SAMPLES));
+    size_t pos = 0;
+    try {
+      while (auto block_size = dec.read_audio_block(decoded, pos)) { pos += block_size; }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << "\n";
+    }
+    if (pos != NUM_SAMPLES || decoded != channels) {
+      std::cerr << "channel assignment " << int{ channel_assignment } << ": " << pos << " samples decoded, expected "
+                << NUM_SAMPLES << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+}// namespace
+
+int main()
+{
+  int failures = 0;
+  for (auto input_type :
+    { FlacDecoder::InputType::File, FlacDecoder::InputType::Mmap, FlacDecoder::InputType::ReadAhead }) {
+    // The 16-bit stream cuts a fake header off at the first window edge, and the first 8-bit frame ends 8 bytes before
+    // that edge, which cuts off the real header after it
+    failures += check_fake_frame_ends(input_type, 16, 4096) + check_fake_frame_ends(input_type, 8, 4035);
+  }
+  for (uint8_t channel_assignment = 8; channel_assignment <= 10; ++channel_assignment) {
+    failures += check_wide_side_channel(channel_assignment);
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <flac_codec/decode/data_format_exception.h>
+#include <flac_codec/decode/frame_index.h>
+#include <flac_codec/decode/frame_scanner.h>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "stream_builder.h"
+
+using namespace flac;
+
+namespace {
+
+  const size_t NUM_SAMPLES = 200000;
+  const uint32_t BLOCK_SIZE = 1024;
+
+  std::vector<FrameLocation> get_frames(const EncodedStream &stream)
+  {
+    std::vector<FrameLocation> frames;
+    for (size_t i = 0; i < stream.m_frame_offsets.size(); ++i) {
+      auto sample = i * BLOCK_SIZE;
+      auto block_size = static_cast<uint32_t>(std::min<size_t>(BLOCK_SIZE, NUM_SAMPLES - sample));
+      frames.push_back({ stream.m_frame_offsets[i], sample, block_size });
+    }
+    return frames;
+  }
+
+  template<typename Exception> bool throws(const std::vector<FrameLocation> &frames, const std::string &flac_file)
+  {
+    try {
+      (void)FrameIndex::build(frames, flac_file);
+      return false;
+    } catch (const Exception &) {
+      return true;
+    }
+  }
+
+  int check_index()
+  {
+    StreamSpec spec;
+    spec.m_block_size = BLOCK_SIZE;
+    auto stream = encode_stream(spec, make_noise(2, NUM_SAMPLES, spec.m_bit_depth, 2));
+    const TempFile file("flac_codec_index.flac", stream.m_bytes);
+    auto frames = get_frames(stream);
+    int failures = 0;
+
+    const TempFile index_file("flac_codec_index.fidx", {});
+    FrameIndex::build(frames, file.get_path()).save(index_file.get_path());
+    auto loaded = FrameIndex::load(index_file.get_path(), file.get_path());
+    auto found = loaded.has_value() ? loaded->find(NUM_SAMPLES - 1) : std::nullopt;
+    if (!found.has_value() || found->m_file_offset != frames.back().m_file_offset) {
+      std::cerr << "saved index does not find the last frame\n";
+      ++failures;
+    }
+
+    // The last frames missing, as after a break in the chain
+    auto truncated = frames;
+    truncated.resize(frames.size() / 2);
+    if (!throws<DataFormatException>(truncated, file.get_path())) {
+      std::cerr << "truncated frames were indexed\n";
+      ++failures;
+    }
+
+    auto short_of_stream_info = frames;
+    short_of_stream_info.back().m_block_size -= 1;
+    if (!throws<DataFormatException>(short_of_stream_info, file.get_path())) {
+      std::cerr << "frames short of STREAMINFO's length were indexed\n";
+      ++failures;
+    }
+
+    // The first frame of the second group before the last one of the first
+    auto swapped = frames;
+    std::swap(swapped[FrameIndex::FRAMES_PER_CHECKPOINT - 1], swapped[FrameIndex::FRAMES_PER_CHECKPOINT]);
+    if (!throws<std::invalid_argument>(swapped, file.get_path())) {
+      std::cerr << "frames out of order across a checkpoint were indexed\n";
+      ++failures;
+    }
+    return failures;
+  }
+
+}// namespace
+
+int main() { return check_index() == 0 ? EXIT_SUCCESS : EXIT_FAILURE; }
@@ -0,0 +1,88 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <flac_codec/decode/data_format_exception.h>
+#include <flac_codec/decode/frame_scanner.h>
+#include <flac_codec/decode/parallel_flac_decoder.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "stream_builder.h"
+
+using namespace flac;
+
+namespace {
+
+  const size_t NUM_SAMPLES = 50000;
+  const uint32_t BLOCK_SIZE = 1024;
+
+  EncodedStream make_stream()
+  {
+    StreamSpec spec;
+    spec.m_block_size = BLOCK_SIZE;
+    spec.m_write_num_samples = false;
+    return encode_stream(spec, make_noise(2, NUM_SAMPLES, spec.m_bit_depth, 1));
+  }
+
+  int check_intact()
+  {
+    auto stream = make_stream();
+    const TempFile file("flac_codec_scanner_intact.flac", stream.m_bytes);
+    auto frames = FrameScanner::scan(file.get_path(), stream.m_frame_offsets.front(), 2);
+    bool same = frames.size() == stream.m_frame_offsets.size();
+    for (size_t i = 0; same && i < frames.size(); ++i) {
+      same = frames[i].m_file_offset == stream.m_frame_offsets[i] && frames[i].m_sample_offset == i * BLOCK_SIZE;
+    }
+    if (!same) {
+      std::cerr << "intact stream: " << frames.size() << " frames, expected " << stream.m_frame_offsets.size() << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  // A frame whose sync code is damaged used to end the chain there, and the scan returned the frames before it
+  int check_damaged(size_t frame)
+  {
+    auto stream = make_stream();
+    stream.m_bytes[stream.m_frame_offsets[frame] + 1] = 0;
+    const TempFile file("flac_codec_scanner_damaged.flac", stream.m_bytes);
+    try {
+      auto frames = FrameScanner::scan(file.get_path(), stream.m_frame_offsets.front(), 2);
+      std::cerr << "damaged frame " << frame << ": scan returned " << frames.size() << " frames\n";
+      return 1;
+    } catch (const DataFormatException &) {
+    }
+    try {
+      const ParallelFlacDecoder dec(file.get_path(), ValidationLevel::Strict, 2);
+      std::cerr << "damaged frame " << frame << ": parallel decoder opened\n";
+      return 1;
+    } catch (const DataFormatException &) {
+    }
+    return 0;
+  }
+
+  // Bytes after the last frame leave it short of the end of the file just the same
+  int check_trailing_bytes()
+  {
+    auto stream = make_stream();
+    stream.m_bytes.insert(stream.m_bytes.end(), { 'T', 'A', 'G' });
+    const TempFile file("flac_codec_scanner_trailing.flac", stream.m_bytes);
+    try {
+      auto frames = FrameScanner::scan(file.get_path(), stream.m_frame_offsets.front(), 1);
+      std::cerr << "trailing bytes: scan returned " << frames.size() << " frames\n";
+      return 1;
+    } catch (const DataFormatException &) {
+      return 0;
+    }
+  }
+
+}// namespace
+
+int main()
+{
+  auto num_frames = (NUM_SAMPLES + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  auto failures = check_intact() + check_damaged(1) + check_damaged(num_frames / 2) + check_damaged(num_frames - 1)
+                  + check_trailing_bytes();
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <flac_codec/common/crc.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace flac {
+
+// MSB-first bit packing, as FLAC lays out every field
+class BitWriter
+{
+public:
+  void write(uint64_t value, size_t num_bits)
+  {
+    for (size_t i = num_bits; i-- > 0;) { push_bit((value >> i) & 1U); }
+  }
+
+  void align()
+  {
+    while (m_num_bits % 8 != 0) { push_bit(0); }
+  }
+
+  [[nodiscard]] const std::vector<uint8_t> &get_bytes() const { return m_bytes; }
+
+private:
+  std::vector<uint8_t> m_bytes;
+  size_t m_num_bits = 0;
+
+  void push_bit(uint64_t bit)
+  {
+    if (m_num_bits % 8 == 0) { m_bytes.push_back(0); }
+    m_bytes.back() = static_cast<uint8_t>(m_bytes.back() | (bit << (7 - m_num_bits % 8)));
+    ++m_num_bits;
+  }
+};
+
+struct StreamSpec
+{
+  uint32_t m_sample_rate = 44100;
+  uint32_t m_bit_depth = 16;
+  uint32_t m_block_size = 4096;
+  // 0 to 7 for that many independent channels minus one, 8 to 10 for left/side, right/side and mid/side
+  uint8_t m_channel_assignment = 1;
+  // 0 in STREAMINFO otherwise, as for a stream whose length was unknown when it was encoded
+  bool m_write_num_samples = true;
+};
+
+struct EncodedStream
+{
+  std::vector<uint8_t> m_bytes;
+  std::vector<size_t> m_frame_offsets;
+};
+
+// A FLAC file with STREAMINFO and fixed-size frames of VERBATIM subframes, so every sample, the wide side channel of a
+// 32-bit stream included, is stored as it is
+inline EncodedStream encode_stream(const StreamSpec &spec, const std::vector<std::vector<int64_t>> &channels)
+{
+  const auto asgn = spec.m_channel_assignment;
+  const size_t num_samples = channels.empty() ? 0 : channels[0].size();
+  if (channels.size() != (asgn < 8 ? asgn + 1U : 2U)) { throw std::invalid_argument("Channel count mismatch"); }
+
+  std::vector<std::vector<uint8_t>> frames;
+  for (size_t start = 0, index = 0; start < num_samples; start += spec.m_block_size, ++index) {
+    auto len = std::min<size_t>(spec.m_block_size, num_samples - start);
+    BitWriter out;
+    out.write(0xFFF8, 16);
+    out.write(7, 4);// Block size minus one in 16 bits after the frame number
+    out.write(0, 4);// Sample rate from STREAMINFO
+    out.write(asgn, 4);
+    out.write(0, 3);// Bit depth from STREAMINFO
+    out.write(0, 1);
+
+    // UTF-8 style frame number
+    if (index < 0x80) {
+      out.write(index, 8);
+    } else {
+      size_t extra = 1;
+      while ((index >> (6 - extra + 6 * extra)) != 0) { ++extra; }
+      out.write(((0xFFU << (7 - extra)) & 0xFFU) | (index >> (6 * extra)), 8);
+      for (size_t i = extra; i-- > 0;) { out.write(0x80U | ((index >> (6 * i)) & 0x3FU), 8); }
+    }
+    out.write(len - 1, 16);
+    out.write(Crc::update_crc8(0, out.get_bytes()), 8);
+
+    for (size_t ch = 0; ch < channels.size(); ++ch) {
+      out.write(0x02, 8);// VERBATIM, no wasted bits
+      const bool side = (asgn == 8 && ch == 1) || (asgn == 9 && ch == 0) || (asgn == 10 && ch == 1);
+      auto depth = spec.m_bit_depth + (side ? 1U : 0U);
+      for (size_t i = start; i < start + len; ++i) {
+        auto left = channels[0][i];
+        auto right = channels[asgn < 8 ? ch : 1][i];
+        int64_t value = asgn < 8 ? channels[ch][i] : left;
+        if (side) {
+          value = left - right;
+        } else if (asgn == 9) {
+          value = right;
+        } else if (asgn == 10) {
+          value = (left + right) >> 1;
+        }
+        out.write(static_cast<uint64_t>(value) & ((uint64_t{ 1 } << depth) - 1U), depth);
+      }
+    }
+    out.align();
+    out.write(Crc::update_crc16(0, out.get_bytes()), 16);
+    frames.push_back(out.get_bytes());
+  }
+
+  size_t min_frame = frames.empty() ? 0 : SIZE_MAX;
+  size_t max_frame = 0;
+  for (const auto &frame : frames) {
+    min_frame = std::min(min_frame, frame.size());
+    max_frame = std::max(max_frame, frame.size());
+  }
+
+  BitWriter head;
+  for (const char c : std::string("fLaC")) { head.write(static_cast<uint8_t>(c), 8); }
+  head.write(1, 1);// Last metadata block
+  head.write(0, 7);
+  head.write(34, 24);
+  head.write(spec.m_block_size, 16);
+  head.write(spec.m_block_size, 16);
+  head.write(min_frame, 24);
+  head.write(max_frame, 24);
+  head.write(spec.m_sample_rate, 20);
+  head.write(channels.size() - 1, 3);
+  head.write(spec.m_bit_depth - 1, 5);
+  head.write(spec.m_write_num_samples ? num_samples : 0, 36);
+  head.write(0, 64);// No MD5
+  head.write(0, 64);
+
+  EncodedStream result{ head.get_bytes(), {} };
+  for (const auto &frame : frames) {
+    result.m_frame_offsets.push_back(result.m_bytes.size());
+    result.m_bytes.insert(result.m_bytes.end(), frame.begin(), frame.end());
+  }
+  return result;
+}
+
+// Full-range pseudo-random samples, the same for the same seed
+inline std::vector<std::vector<int64_t>>
+  make_noise(size_t num_channels, size_t num_samples, uint32_t bit_depth, uint64_t seed)
+{
+  std::vector<std::vector<int64_t>> result(num_channels, std::vector<int64_t>(num_samples));
+  for (auto &channel : result) {
+    for (auto &sample : channel) {
+      seed = seed * 6364136223846793005U + 1442695040888963407U;
+      sample = static_cast<int64_t>(seed) >> (64U - bit_depth);
+    }
+  }
+  return result;
+}
+
+// A file in the temporary directory that is removed again with the object
+class TempFile
+{
+public:
+  TempFile(const std::string &name, const std::vector<uint8_t> &bytes)
+    : m_path((std::filesystem::temp_directory_path() / name).string())
+  {
+    std::ofstream out(m_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));// NOLINT
+    if (!out) { throw std::runtime_error("Failed to write " + m_path); }
+  }
+  ~TempFile() { std::filesystem::remove(m_path); }
+  TempFile(const TempFile &) = delete;
+  TempFile &operator=(const TempFile &) = delete;
+  TempFile(TempFile &&) = delete;
+  TempFile &operator=(TempFile &&) = delete;
+
+  [[nodiscard]] const std::string &get_path() const { return m_path; }
+
+private:
+  std::string m_path;
+};
+
+}// namespace flac